@@ -16,6 +16,7 @@ extern int64_t max_delay;
 extern int64_t max_advance;
 
 extern bool one_insn_per_tb;
+extern uint64_t tcg_halt_poll_ns;
 
 /*
  * Return true if CS is not running in parallel with other cpus, either
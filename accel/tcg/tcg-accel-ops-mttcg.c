@@ -30,11 +30,19 @@
 #include "qemu/main-loop.h"
 #include "qemu/notify.h"
 #include "qemu/guest-random.h"
+#include "qemu/processor.h"
+#include "qemu/timer.h"
 #include "exec/exec-all.h"
 #include "hw/boards.h"
 #include "tcg/startup.h"
 #include "tcg-accel-ops.h"
 #include "tcg-accel-ops-mttcg.h"
+#include "internal-common.h"
+#include "trace.h"
+
+/* Initial poll window and growth factor, as in KVM's halt polling */
+#define HALT_POLL_NS_START  10000
+#define HALT_POLL_NS_GROW   2
 
 typedef struct MttcgForceRcuNotifier {
     Notifier notifier;
@@ -56,6 +64,58 @@ static void mttcg_force_rcu(Notifier *notify, void *data)
     async_run_on_cpu(cpu, do_nothing, RUN_ON_CPU_NULL);
 }
 
+/*
+ * Wait until the vCPU has something to do.  If it is halted, first spin
+ * for up to *poll_ns without the BQL: every wakeup source goes through
+ * qemu_cpu_kick(), which sets exit_request, so a kick that arrives within
+ * the window is seen without a trip through the futex.  The window then
+ * adapts to the vCPU's wakeup history: it grows when the vCPU slept for
+ * less than the maximum poll time and collapses when it slept longer,
+ * so that vCPUs that stay idle do not keep burning host CPU.
+ */
+static void mttcg_wait_io_event(CPUState *cpu, uint64_t *poll_ns)
+{
+    uint64_t max_ns = qatomic_read(&tcg_halt_poll_ns);
+    int64_t start, poll_end, now;
+    bool woken = false;
+
+    if (!max_ns || !cpu_thread_is_idle(cpu)) {
+        *poll_ns = MIN(*poll_ns, max_ns);
+        qemu_wait_io_event(cpu);
+        return;
+    }
+
+    start = get_clock();
+    if (*poll_ns) {
+        poll_end = start + MIN(*poll_ns, max_ns);
+        bql_unlock();
+        do {
+            if (qatomic_read(&cpu->exit_request)) {
+                woken = true;
+                break;
+            }
+            cpu_relax();
+        } while (get_clock() < poll_end);
+        bql_lock();
+    }
+
+    qemu_wait_io_event(cpu);
+
+    now = get_clock();
+    trace_mttcg_halt_poll(cpu->cpu_index, *poll_ns, now - start, woken);
+    if (woken) {
+        return;
+    }
+    if ((uint64_t)(now - start) > max_ns) {
+        /* Long sleep: polling would not have helped */
+        *poll_ns = 0;
+    } else if (*poll_ns < max_ns) {
+        *poll_ns = *poll_ns ? *poll_ns * HALT_POLL_NS_GROW
+                            : HALT_POLL_NS_START;
+        *poll_ns = MIN(*poll_ns, max_ns);
+    }
+}
+
 /*
  * In the multi-threaded case each vCPU has its own thread. The TLS
  * variable current_cpu can be used deep in the code to find the
@@ -66,6 +126,7 @@ static void *mttcg_cpu_thread_fn(void *arg)
 {
     MttcgForceRcuNotifier force_rcu;
     CPUState *cpu = arg;
+    uint64_t halt_poll_ns = 0;
 
     assert(tcg_enabled());
     g_assert(!icount_enabled());
@@ -115,7 +176,7 @@ static void *mttcg_cpu_thread_fn(void *arg)
         }
 
         qatomic_set_mb(&cpu->exit_request, 0);
-        qemu_wait_io_event(cpu);
+        mttcg_wait_io_event(cpu, &halt_poll_ns);
     } while (!cpu->unplug || cpu_can_run(cpu));
 
     tcg_cpu_destroy(cpu);
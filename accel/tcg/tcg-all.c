@@ -99,6 +99,7 @@ static void tcg_accel_instance_init(Object *obj)
 
 bool mttcg_enabled;
 bool one_insn_per_tb;
+uint64_t tcg_halt_poll_ns;
 
 static int tcg_init_machine(MachineState *ms)
 {
@@ -207,6 +208,29 @@ static void tcg_set_one_insn_per_tb(Object *obj, bool value, Error **errp)
     qatomic_set(&one_insn_per_tb, value);
 }
 
+static void tcg_get_halt_poll_ns(Object *obj, Visitor *v,
+                                 const char *name, void *opaque,
+                                 Error **errp)
+{
+    uint64_t value = qatomic_read(&tcg_halt_poll_ns);
+
+    visit_type_uint64(v, name, &value, errp);
+}
+
+static void tcg_set_halt_poll_ns(Object *obj, Visitor *v,
+                                 const char *name, void *opaque,
+                                 Error **errp)
+{
+    uint64_t value;
+
+    if (!visit_type_uint64(v, name, &value, errp)) {
+        return;
+    }
+
+    /* Can be changed at run time with qom-set */
+    qatomic_set(&tcg_halt_poll_ns, value);
+}
+
 static int tcg_gdbstub_supported_sstep_flags(void)
 {
     /*
@@ -252,6 +276,12 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
                                    tcg_set_one_insn_per_tb);
     object_class_property_set_description(oc, "one-insn-per-tb",
         "Only put one guest insn in each translation block");
+
+    object_class_property_add(oc, "halt-poll-ns", "uint64",
+        tcg_get_halt_poll_ns, tcg_set_halt_poll_ns,
+        NULL, NULL);
+    object_class_property_set_description(oc, "halt-poll-ns",
+        "Maximum time a halted vCPU polls for a wakeup before sleeping");
 }
 
 static const TypeInfo tcg_accel_type = {
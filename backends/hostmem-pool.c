@@ -0,0 +1,283 @@
+/*
+ * QEMU host memory backend backed by an external huge page pool
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "sysemu/hostmem.h"
+#include "qom/object_interfaces.h"
+#include "qemu/memfd.h"
+#include "qemu/error-report.h"
+#include "qemu/module.h"
+#include "qapi/error.h"
+#include "qapi/visitor.h"
+#include "io/channel.h"
+#include "io/channel-socket.h"
+#include "qom/object.h"
+#include "trace.h"
+
+#define TYPE_MEMORY_BACKEND_POOL "memory-backend-pool"
+
+OBJECT_DECLARE_SIMPLE_TYPE(HostMemoryBackendPool, MEMORY_BACKEND_POOL)
+
+/*
+ * Protocol spoken with the pool daemon over a Unix domain socket, see
+ * docs/interop/memory-backend-pool.rst.
+ */
+#define POOL_MAGIC      0x4c4f4f50 /* "POOL" */
+#define POOL_VERSION    1
+
+typedef struct PoolRequest {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    uint64_t page_size;
+} PoolRequest;
+
+typedef struct PoolReply {
+    uint32_t magic;
+    int32_t status;
+    uint64_t size;
+} PoolReply;
+
+struct HostMemoryBackendPool {
+    HostMemoryBackend parent_obj;
+
+    char *path;
+    uint64_t hugetlbsize;
+    bool fallback;
+
+    /* Connection to the pool daemon, owning the memory while open. */
+    QIOChannel *ioc;
+};
+
+static int pool_backend_request(HostMemoryBackendPool *m, Error **errp)
+{
+    HostMemoryBackend *backend = MEMORY_BACKEND(m);
+    SocketAddress saddr = {
+        .type = SOCKET_ADDRESS_TYPE_UNIX,
+        .u.q_unix.path = m->path,
+    };
+    QIOChannelSocket *sioc = qio_channel_socket_new();
+    QIOChannel *ioc = QIO_CHANNEL(sioc);
+    PoolRequest req = {
+        .magic = POOL_MAGIC,
+        .version = POOL_VERSION,
+        .size = backend->size,
+        .page_size = m->hugetlbsize,
+    };
+    PoolReply reply;
+    struct iovec iov = { .iov_base = &reply, .iov_len = sizeof(reply) };
+    int *fds = NULL;
+    size_t nfds = 0;
+    struct stat st;
+    int fd = -1;
+
+    qio_channel_set_name(ioc, "memory-backend-pool");
+    if (qio_channel_socket_connect_sync(sioc, &saddr, errp) < 0) {
+        goto out;
+    }
+    if (qio_channel_write_all(ioc, (char *)&req, sizeof(req), errp) < 0 ||
+        qio_channel_readv_full_all(ioc, &iov, 1, &fds, &nfds, errp) < 0) {
+        goto out;
+    }
+
+    if (reply.magic != POOL_MAGIC) {
+        error_setg(errp, "invalid reply from pool '%s'", m->path);
+    } else if (reply.status) {
+        error_setg_errno(errp, -reply.status,
+                         "pool '%s' cannot provide %" PRIu64 " bytes",
+                         m->path, backend->size);
+    } else if (nfds != 1) {
+        error_setg(errp, "pool '%s' did not pass a file descriptor", m->path);
+    } else if (fstat(fds[0], &st) < 0) {
+        error_setg_errno(errp, errno, "cannot stat memory of pool '%s'",
+                         m->path);
+    } else if (st.st_size < backend->size) {
+        /* Don't trust reply.size, mapping beyond the end would SIGBUS */
+        error_setg(errp, "pool '%s' provided %" PRIu64 " bytes, %" PRIu64
+                   " bytes are needed", m->path, (uint64_t)st.st_size,
+                   backend->size);
+    } else {
+        fd = fds[0];
+        nfds = 0;
+        m->ioc = ioc;
+        ioc = NULL;
+    }
+
+out:
+    for (size_t i = 0; i < nfds; i++) {
+        close(fds[i]);
+    }
+    g_free(fds);
+    if (ioc) {
+        object_unref(OBJECT(ioc));
+    }
+    return fd;
+}
+
+static bool
+pool_backend_memory_alloc(HostMemoryBackend *backend, Error **errp)
+{
+    HostMemoryBackendPool *m = MEMORY_BACKEND_POOL(backend);
+    g_autofree char *name = NULL;
+    Error *local_err = NULL;
+    uint32_t ram_flags;
+    int fd;
+
+    if (!backend->size) {
+        error_setg(errp, "can't create backend with size 0");
+        return false;
+    }
+    if (!m->path) {
+        error_setg(errp, "'path' property is not set");
+        return false;
+    }
+    if (!backend->share) {
+        error_setg(errp, "can't create pool backend with 'share=off'");
+        return false;
+    }
+
+    fd = pool_backend_request(m, &local_err);
+    trace_pool_backend_memory_alloc(m->path, backend->size, fd);
+    if (fd < 0) {
+        if (!m->fallback) {
+            error_propagate(errp, local_err);
+            return false;
+        }
+        warn_report_err(local_err);
+        warn_report("memory-backend-pool: falling back to a local allocation");
+
+        /* Plain shared memory, like memory-backend-memfd with hugetlb=off */
+        fd = qemu_memfd_create(TYPE_MEMORY_BACKEND_POOL, backend->size,
+                               false, 0, 0, errp);
+        if (fd == -1) {
+            return false;
+        }
+    }
+
+    backend->aligned = true;
+    name = host_memory_backend_get_name(backend);
+    ram_flags = RAM_SHARED;
+    ram_flags |= backend->reserve ? 0 : RAM_NORESERVE;
+    return memory_region_init_ram_from_fd(&backend->mr, OBJECT(backend), name,
+                                          backend->size, ram_flags, fd, 0, errp);
+}
+
+static char *pool_backend_get_path(Object *o, Error **errp)
+{
+    return g_strdup(MEMORY_BACKEND_POOL(o)->path);
+}
+
+static void pool_backend_set_path(Object *o, const char *str, Error **errp)
+{
+    HostMemoryBackendPool *m = MEMORY_BACKEND_POOL(o);
+
+    if (host_memory_backend_mr_inited(MEMORY_BACKEND(o))) {
+        error_setg(errp, "cannot change property 'path' of %s",
+                   object_get_typename(o));
+        return;
+    }
+    g_free(m->path);
+    m->path = g_strdup(str);
+}
+
+static void
+pool_backend_set_hugetlbsize(Object *obj, Visitor *v, const char *name,
+                             void *opaque, Error **errp)
+{
+    HostMemoryBackendPool *m = MEMORY_BACKEND_POOL(obj);
+    uint64_t value;
+
+    if (host_memory_backend_mr_inited(MEMORY_BACKEND(obj))) {
+        error_setg(errp, "cannot change property value");
+        return;
+    }
+
+    if (!visit_type_size(v, name, &value, errp)) {
+        return;
+    }
+    m->hugetlbsize = value;
+}
+
+static void
+pool_backend_get_hugetlbsize(Object *obj, Visitor *v, const char *name,
+                             void *opaque, Error **errp)
+{
+    HostMemoryBackendPool *m = MEMORY_BACKEND_POOL(obj);
+    uint64_t value = m->hugetlbsize;
+
+    visit_type_size(v, name, &value, errp);
+}
+
+static bool pool_backend_get_fallback(Object *o, Error **errp)
+{
+    return MEMORY_BACKEND_POOL(o)->fallback;
+}
+
+static void pool_backend_set_fallback(Object *o, bool value, Error **errp)
+{
+    MEMORY_BACKEND_POOL(o)->fallback = value;
+}
+
+static void pool_backend_instance_init(Object *obj)
+{
+    HostMemoryBackendPool *m = MEMORY_BACKEND_POOL(obj);
+
+    m->fallback = true;
+    MEMORY_BACKEND(m)->share = true;
+}
+
+static void pool_backend_instance_finalize(Object *obj)
+{
+    HostMemoryBackendPool *m = MEMORY_BACKEND_POOL(obj);
+
+    /* Closing the connection hands the memory back to the pool. */
+    if (m->ioc) {
+        qio_channel_close(m->ioc, NULL);
+        object_unref(OBJECT(m->ioc));
+    }
+    g_free(m->path);
+}
+
+static void pool_backend_class_init(ObjectClass *oc, void *data)
+{
+    HostMemoryBackendClass *bc = MEMORY_BACKEND_CLASS(oc);
+
+    bc->alloc = pool_backend_memory_alloc;
+
+    object_class_property_add_str(oc, "path",
+                                  pool_backend_get_path,
+                                  pool_backend_set_path);
+    object_class_property_set_description(oc, "path",
+        "Unix socket of the huge page pool daemon");
+    object_class_property_add(oc, "hugetlbsize", "int",
+                              pool_backend_get_hugetlbsize,
+                              pool_backend_set_hugetlbsize,
+                              NULL, NULL);
+    object_class_property_set_description(oc, "hugetlbsize",
+        "Huge pages size (ex: 2M, 1G)");
+    object_class_property_add_bool(oc, "fallback",
+                                   pool_backend_get_fallback,
+                                   pool_backend_set_fallback);
+    object_class_property_set_description(oc, "fallback",
+        "Allocate memory locally if the pool is unavailable");
+}
+
+static const TypeInfo pool_backend_info = {
+    .name = TYPE_MEMORY_BACKEND_POOL,
+    .parent = TYPE_MEMORY_BACKEND,
+    .instance_init = pool_backend_instance_init,
+    .instance_finalize = pool_backend_instance_finalize,
+    .class_init = pool_backend_class_init,
+    .instance_size = sizeof(HostMemoryBackendPool),
+};
+
+static void register_types(void)
+{
+    type_register_static(&pool_backend_info);
+}
+
+type_init(register_types);
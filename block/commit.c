@@ -21,16 +21,32 @@
 #include "qemu/ratelimit.h"
 #include "qemu/memalign.h"
 #include "sysemu/block-backend.h"
+#include "block/aio_task.h"
 
 enum {
     /*
-     * Size of data buffer for populating the image file.  This should be large
-     * enough to process multiple clusters in a single call, so that populating
-     * contiguous regions of the image is efficient.
+     * Bounds and initial value of the size of a single copy request, which
+     * is adapted at run time.  Contiguous allocated areas are copied in
+     * requests of up to this size.
      */
-    COMMIT_BUFFER_SIZE = 512 * 1024, /* in bytes */
+    COMMIT_MIN_CHUNK = 64 * 1024, /* in bytes */
+    COMMIT_MAX_CHUNK = 4 * 1024 * 1024, /* in bytes */
+    COMMIT_INIT_CHUNK = 2 * 1024 * 1024, /* in bytes */
+    /*
+     * Number of copy requests in flight, bounding the memory used for
+     * buffers to COMMIT_MAX_WORKERS * COMMIT_MAX_CHUNK.
+     */
+    COMMIT_MAX_WORKERS = 8,
 };
 
+/* A chunk whose copy failed, waiting for the error action to be applied */
+typedef struct CommitFailedChunk {
+    int64_t offset;
+    int64_t bytes;
+    int ret;
+    bool error_in_source;
+} CommitFailedChunk;
+
 typedef struct CommitBlockJob {
     BlockJob common;
     BlockDriverState *commit_top_bs;
@@ -43,8 +59,20 @@ typedef struct CommitBlockJob {
     bool chain_frozen;
     char *backing_file_str;
     bool backing_mask_protocol;
+    /* CommitFailedChunk array, filled by the copy tasks */
+    GArray *failed;
+    AioTaskPool *pool;
+    int in_flight;
+    BlockJobChunkTuner tuner;
 } CommitBlockJob;
 
+typedef struct CommitTask {
+    AioTask task;
+    CommitBlockJob *s;
+    int64_t offset;
+    int64_t bytes;
+} CommitTask;
+
 static int commit_prepare(Job *job)
 {
     CommitBlockJob *s = container_of(job, CommitBlockJob, common.job);
@@ -126,13 +154,82 @@ static void commit_clean(Job *job)
     blk_unref(s->top);
 }
 
+static int coroutine_fn commit_task_entry(AioTask *task)
+{
+    CommitTask *t = container_of(task, CommitTask, task);
+    CommitBlockJob *s = t->s;
+    bool error_in_source = true;
+    void *buf;
+    int ret;
+
+    s->in_flight++;
+
+    buf = blk_try_blockalign(s->top, t->bytes);
+    if (!buf) {
+        ret = -ENOMEM;
+    } else {
+        ret = blk_co_pread(s->top, t->offset, t->bytes, buf, 0);
+        if (ret >= 0) {
+            ret = blk_co_pwrite(s->base, t->offset, t->bytes, buf, 0);
+            if (ret < 0) {
+                error_in_source = false;
+            }
+        }
+        qemu_vfree(buf);
+    }
+    s->in_flight--;
+
+    if (ret < 0) {
+        /* Let commit_run() decide whether to retry */
+        CommitFailedChunk chunk = {
+            .offset = t->offset,
+            .bytes = t->bytes,
+            .ret = ret,
+            .error_in_source = error_in_source,
+        };
+        g_array_append_val(s->failed, chunk);
+        return 0;
+    }
+
+    /* Publish progress */
+    job_progress_update(&s->common.job, t->bytes);
+    block_job_chunk_done(&s->tuner, t->bytes);
+    return 0;
+}
+
+static void coroutine_fn commit_start_task(CommitBlockJob *s,
+                                           int64_t offset, int64_t bytes)
+{
+    CommitTask *t = g_new(CommitTask, 1);
+
+    *t = (CommitTask) {
+        .task.func = commit_task_entry,
+        .s = s,
+        .offset = offset,
+        .bytes = bytes,
+    };
+    block_job_ratelimit_processed_bytes(&s->common, bytes);
+    aio_task_pool_start_task(s->pool, &t->task);
+}
+
+static void coroutine_fn commit_pause(Job *job)
+{
+    CommitBlockJob *s = container_of(job, CommitBlockJob, common.job);
+
+    /* No copy may be in flight while the job is paused */
+    if (s->pool) {
+        aio_task_pool_wait_all(s->pool);
+        block_job_chunk_tuner_restart(&s->tuner);
+    }
+}
+
 static int coroutine_fn commit_run(Job *job, Error **errp)
 {
     CommitBlockJob *s = container_of(job, CommitBlockJob, common.job);
-    int64_t offset;
+    CommitFailedChunk retry = { .bytes = 0 };
+    int64_t offset = 0;
     int ret = 0;
     int64_t n = 0; /* bytes */
-    QEMU_AUTO_VFREE void *buf = NULL;
     int64_t len, base_len;
 
     len = blk_co_getlength(s->top);
@@ -153,55 +250,93 @@ static int coroutine_fn commit_run(Job *job, Error **errp)
         }
     }
 
-    buf = blk_blockalign(s->top, COMMIT_BUFFER_SIZE);
+    /*
+     * Allocated areas are copied by up to COMMIT_MAX_WORKERS tasks in
+     * parallel; failed chunks are handed back here so that the error action
+     * is applied from the job coroutine.
+     */
+    s->failed = g_array_new(false, false, sizeof(CommitFailedChunk));
+    s->pool = aio_task_pool_new(COMMIT_MAX_WORKERS);
+    block_job_chunk_tuner_init(&s->tuner, COMMIT_MIN_CHUNK, COMMIT_MAX_CHUNK,
+                               COMMIT_INIT_CHUNK);
 
-    for (offset = 0; offset < len; offset += n) {
-        bool copy;
-        bool error_in_source = true;
+    while (true) {
+        BlockErrorAction action;
 
-        /* Note that even when no rate limit is applied we need to yield
-         * with no pending I/O here so that bdrv_drain_all() returns.
+        /*
+         * Even when no rate limit is applied we need to yield here so that
+         * the job can be paused and bdrv_drain_all() returns.
          */
         block_job_ratelimit_sleep(&s->common);
         if (job_is_cancelled(&s->common.job)) {
             break;
         }
-        /* Copy if allocated above the base */
-        ret = blk_co_is_allocated_above(s->top, s->base_overlay, true,
-                                        offset, COMMIT_BUFFER_SIZE, &n);
-        copy = (ret > 0);
-        trace_commit_one_iteration(s, offset, n, ret);
-        if (copy) {
-            assert(n < SIZE_MAX);
 
-            ret = blk_co_pread(s->top, offset, n, buf, 0);
-            if (ret >= 0) {
-                ret = blk_co_pwrite(s->base, offset, n, buf, 0);
-                if (ret < 0) {
-                    error_in_source = false;
-                }
+        /* Retry a failed chunk only after the job had a chance to pause */
+        if (retry.bytes) {
+            commit_start_task(s, retry.offset, retry.bytes);
+            retry.bytes = 0;
+            continue;
+        }
+
+        if (offset >= len && !s->failed->len) {
+            aio_task_pool_wait_all(s->pool);
+            if (!s->failed->len) {
+                break;
             }
         }
+
+        if (s->failed->len) {
+            retry = g_array_index(s->failed, CommitFailedChunk, 0);
+            g_array_remove_index(s->failed, 0);
+            action = block_job_error_action(&s->common, s->on_error,
+                                            retry.error_in_source, -retry.ret);
+            if (action == BLOCK_ERROR_ACTION_REPORT) {
+                ret = retry.ret;
+                break;
+            }
+            continue;
+        }
+
+        /*
+         * Copy if allocated above the base.  Query the whole remaining range
+         * so that unallocated areas are skipped in a single step.
+         */
+        ret = blk_co_is_allocated_above(s->top, s->base_overlay, true,
+                                        offset, len - offset, &n);
+        trace_commit_one_iteration(s, offset, n, ret);
         if (ret < 0) {
-            BlockErrorAction action =
-                block_job_error_action(&s->common, s->on_error,
-                                       error_in_source, -ret);
+            action = block_job_error_action(&s->common, s->on_error, true,
+                                            -ret);
             if (action == BLOCK_ERROR_ACTION_REPORT) {
-                return ret;
-            } else {
-                n = 0;
-                continue;
+                break;
             }
+            /* Stopped or ignored, the error must not outlive a cancel */
+            ret = 0;
+            continue;
         }
-        /* Publish progress */
-        job_progress_update(&s->common.job, n);
 
-        if (copy) {
-            block_job_ratelimit_processed_bytes(&s->common, n);
+        if (ret > 0) {
+            bool saturated = s->in_flight == COMMIT_MAX_WORKERS;
+
+            n = MIN(n, block_job_chunk_size(&s->common, &s->tuner, saturated));
+            assert(n < SIZE_MAX);
+            commit_start_task(s, offset, n);
+        } else {
+            /* Publish progress */
+            job_progress_update(&s->common.job, n);
         }
+        offset += n;
+        ret = 0;
     }
 
-    return 0;
+    aio_task_pool_wait_all(s->pool);
+    aio_task_pool_free(s->pool);
+    s->pool = NULL;
+    g_array_free(s->failed, true);
+    s->failed = NULL;
+
+    return ret < 0 ? ret : 0;
 }
 
 static const BlockJobDriver commit_job_driver = {
@@ -211,6 +346,7 @@ static const BlockJobDriver commit_job_driver = {
         .free          = block_job_free,
         .user_resume   = block_job_user_resume,
         .run           = commit_run,
+        .pause         = commit_pause,
         .prepare       = commit_prepare,
         .abort         = commit_abort,
         .clean         = commit_clean
@@ -577,6 +577,28 @@ void bdrv_drain_all(void)
     bdrv_drain_all_end();
 }
 
+/* Called with req->bs->reqs_lock held */
+static IntervalTreeRoot *tracked_request_tree(BdrvTrackedRequest *req)
+{
+    BlockDriverState *bs = req->bs;
+
+    return req->serialising ? &bs->serialising_requests : &bs->plain_requests;
+}
+
+/*
+ * Index @req by its overlap range.  Interval tree ranges are inclusive and
+ * cannot be empty, so a zero-length request is indexed as the single byte at
+ * its offset; lookups are always filtered through tracked_request_overlaps().
+ *
+ * Called with req->bs->reqs_lock held.
+ */
+static void tracked_request_index(BdrvTrackedRequest *req)
+{
+    req->node.start = req->overlap_offset;
+    req->node.last = req->overlap_offset + MAX(req->overlap_bytes, 1) - 1;
+    interval_tree_insert(&req->node, tracked_request_tree(req));
+}
+
 /**
  * Remove an active request from the tracked requests list
  *
@@ -590,6 +612,7 @@ static void coroutine_fn tracked_request_end(BdrvTrackedRequest *req)
 
     qemu_mutex_lock(&req->bs->reqs_lock);
     QLIST_REMOVE(req, list);
+    interval_tree_remove(&req->node, tracked_request_tree(req));
     qemu_mutex_unlock(&req->bs->reqs_lock);
 
     /*
@@ -626,6 +649,7 @@ static void coroutine_fn tracked_request_begin(BdrvTrackedRequest *req,
 
     qemu_mutex_lock(&bs->reqs_lock);
     QLIST_INSERT_HEAD(&bs->tracked_requests, req, list);
+    tracked_request_index(req);
     qemu_mutex_unlock(&bs->reqs_lock);
 }
 
@@ -645,14 +669,24 @@ static bool tracked_request_overlaps(BdrvTrackedRequest *req,
     return true;
 }
 
-/* Called with self->bs->reqs_lock held */
+/*
+ * Return a request in @root other than @self whose overlap range intersects
+ * that of @self and that is not itself waiting.
+ *
+ * Called with self->bs->reqs_lock held.
+ */
 static coroutine_fn BdrvTrackedRequest *
-bdrv_find_conflicting_request(BdrvTrackedRequest *self)
+tracked_request_find_overlap(IntervalTreeRoot *root, BdrvTrackedRequest *self)
 {
-    BdrvTrackedRequest *req;
+    uint64_t start = self->node.start;
+    uint64_t last = self->node.last;
+    IntervalTreeNode *node;
+
+    for (node = interval_tree_iter_first(root, start, last); node;
+         node = interval_tree_iter_next(node, start, last)) {
+        BdrvTrackedRequest *req = container_of(node, BdrvTrackedRequest, node);
 
-    QLIST_FOREACH(req, &self->bs->tracked_requests, list) {
-        if (req == self || (!req->serialising && !self->serialising)) {
+        if (req == self) {
             continue;
         }
         if (tracked_request_overlaps(req, self->overlap_offset,
@@ -679,6 +713,22 @@ bdrv_find_conflicting_request(BdrvTrackedRequest *self)
     return NULL;
 }
 
+/* Called with self->bs->reqs_lock held */
+static coroutine_fn BdrvTrackedRequest *
+bdrv_find_conflicting_request(BdrvTrackedRequest *self)
+{
+    BlockDriverState *bs = self->bs;
+    BdrvTrackedRequest *req;
+
+    /* Two requests only conflict if at least one of them is serialising */
+    req = tracked_request_find_overlap(&bs->serialising_requests, self);
+    if (!req && self->serialising) {
+        req = tracked_request_find_overlap(&bs->plain_requests, self);
+    }
+
+    return req;
+}
+
 /* Called with self->bs->reqs_lock held */
 static void coroutine_fn
 bdrv_wait_serialising_requests_locked(BdrvTrackedRequest *self)
@@ -702,6 +752,8 @@ static void tracked_request_set_serialising(BdrvTrackedRequest *req,
 
     bdrv_check_request(req->offset, req->bytes, &error_abort);
 
+    interval_tree_remove(&req->node, tracked_request_tree(req));
+
     if (!req->serialising) {
         qatomic_inc(&req->bs->serialising_in_flight);
         req->serialising = true;
@@ -709,6 +761,8 @@ static void tracked_request_set_serialising(BdrvTrackedRequest *req,
 
     req->overlap_offset = MIN(req->overlap_offset, overlap_offset);
     req->overlap_bytes = MAX(req->overlap_bytes, overlap_bytes);
+
+    tracked_request_index(req);
 }
 
 /**
@@ -24,11 +24,16 @@
 #include "qemu/ratelimit.h"
 #include "qemu/bitmap.h"
 #include "qemu/memalign.h"
+#include "qemu/stats64.h"
 
 #define MAX_IN_FLIGHT 16
 #define MAX_IO_BYTES (1 << 20) /* 1 Mb */
 #define DEFAULT_MIRROR_BUF_SIZE (MAX_IN_FLIGHT * MAX_IO_BYTES)
 
+/* Bounds for the adaptive tuning, see mirror_tune() */
+#define MIRROR_MAX_IN_FLIGHT 256
+#define MIRROR_MIN_IO_BYTES (64 * 1024)
+
 /* The mirroring buffer is a list of granularity-sized chunks.
  * Free chunks are organized in a list.
  */
@@ -94,6 +99,19 @@ typedef struct MirrorBlockJob {
     bool prepared;
     bool in_drain;
     bool base_ro;
+
+    /*
+     * Adaptive tuning of the copy requests, see mirror_tune().  The current
+     * limits and the measured throughput are read by mirror_query() and
+     * therefore accessed with atomics.
+     */
+    BlockJobChunkTuner tuner;
+    unsigned max_in_flight;
+    int max_io_bytes;
+    Stat64 throughput;
+    bool tuned;
+    /* Set when the job ran out of in-flight slots or buffers */
+    bool saturated;
 } MirrorBlockJob;
 
 typedef struct MirrorBDSOpaque {
@@ -115,6 +133,8 @@ struct MirrorOp {
     bool is_pseudo_op;
     bool is_active_write;
     bool is_in_flight;
+    /* A copy, as opposed to zeroing or discarding */
+    bool is_copy;
     CoQueue waiting_requests;
     Coroutine *co;
     MirrorOp *waiting_for_op;
@@ -194,6 +214,53 @@ static void coroutine_fn mirror_wait_on_conflicts(MirrorOp *self,
     }
 }
 
+/* Bounds of the size of a single copy request */
+static int mirror_min_io_bytes(MirrorBlockJob *s)
+{
+    return MAX(s->granularity, MIRROR_MIN_IO_BYTES);
+}
+
+static int mirror_max_io_bytes(MirrorBlockJob *s)
+{
+    uint64_t max_bytes = MIN(s->buf_size, s->granularity * s->max_iov);
+
+    max_bytes = MIN(max_bytes, QEMU_ALIGN_DOWN(BDRV_REQUEST_MAX_BYTES,
+                                               s->granularity));
+    return MAX(max_bytes, mirror_min_io_bytes(s));
+}
+
+static void mirror_set_io_bytes(MirrorBlockJob *s, int io_bytes)
+{
+    unsigned max_in_flight = s->buf_size / io_bytes;
+
+    max_in_flight = MAX(max_in_flight, MAX_IN_FLIGHT);
+    max_in_flight = MIN(max_in_flight, MIRROR_MAX_IN_FLIGHT);
+    qatomic_set(&s->max_io_bytes, io_bytes);
+    qatomic_set(&s->max_in_flight, max_in_flight);
+}
+
+/*
+ * The copy request size is adapted by the block job chunk tuner to the
+ * throughput measured in the windows in which the job ran out of in-flight
+ * slots or buffers.  The number of requests in flight follows so that they
+ * keep using the whole buffer, i.e. smaller requests mean more of them in
+ * flight.
+ */
+static void mirror_tune(MirrorBlockJob *s)
+{
+    int io_bytes = block_job_chunk_size(&s->common, &s->tuner, s->saturated);
+
+    s->saturated = false;
+    if (s->tuner.bw) {
+        stat64_set(&s->throughput, s->tuner.bw);
+        qatomic_set(&s->tuned, true);
+    }
+    if (io_bytes != s->max_io_bytes) {
+        mirror_set_io_bytes(s, io_bytes);
+        trace_mirror_tune(s, s->tuner.bw, s->max_in_flight, s->max_io_bytes);
+    }
+}
+
 static void coroutine_fn mirror_iteration_done(MirrorOp *op, int ret)
 {
     MirrorBlockJob *s = op->s;
@@ -224,6 +291,9 @@ static void coroutine_fn mirror_iteration_done(MirrorOp *op, int ret)
         if (!s->initial_zeroing_ongoing) {
             job_progress_update(&s->common.job, op->bytes);
         }
+        if (op->is_copy) {
+            block_job_chunk_done(&s->tuner, op->bytes);
+        }
     }
     qemu_iovec_destroy(&op->qiov);
 
@@ -376,6 +446,7 @@ static void coroutine_fn mirror_co_read(void *opaque)
 
     while (s->buf_free_count < nb_chunks) {
         trace_mirror_yield_in_flight(s, op->offset, s->in_flight);
+        s->saturated = true;
         mirror_wait_for_free_in_flight_slot(s);
     }
 
@@ -396,6 +467,7 @@ static void coroutine_fn mirror_co_read(void *opaque)
     s->in_flight++;
     s->bytes_in_flight += op->bytes;
     op->is_in_flight = true;
+    op->is_copy = true;
     trace_mirror_one_iteration(s, op->offset, op->bytes);
 
     WITH_GRAPH_RDLOCK_GUARD() {
@@ -488,7 +560,10 @@ static void coroutine_fn GRAPH_UNLOCKED mirror_iteration(MirrorBlockJob *s)
     /* At least the first dirty chunk is mirrored in one iteration. */
     int nb_chunks = 1;
     bool write_zeroes_ok = bdrv_can_write_zeroes_with_unmap(blk_bs(s->target));
-    int max_io_bytes = MAX(s->buf_size / MAX_IN_FLIGHT, MAX_IO_BYTES);
+    int max_io_bytes;
+
+    mirror_tune(s);
+    max_io_bytes = s->max_io_bytes;
 
     bdrv_graph_co_rdlock();
     source = s->mirror_top_bs->backing->bs;
@@ -600,8 +675,9 @@ static void coroutine_fn GRAPH_UNLOCKED mirror_iteration(MirrorBlockJob *s)
             }
         }
 
-        while (s->in_flight >= MAX_IN_FLIGHT) {
+        while (s->in_flight >= s->max_in_flight) {
             trace_mirror_yield_in_flight(s, offset, s->in_flight);
+            s->saturated = true;
             mirror_wait_for_free_in_flight_slot(s);
         }
 
@@ -866,7 +942,7 @@ static int coroutine_fn GRAPH_UNLOCKED mirror_dirty_init(MirrorBlockJob *s)
                 return 0;
             }
 
-            if (s->in_flight >= MAX_IN_FLIGHT) {
+            if (s->in_flight >= s->max_in_flight) {
                 trace_mirror_yield(s, UINT64_MAX, s->buf_free_count,
                                    s->in_flight);
                 mirror_wait_for_free_in_flight_slot(s);
@@ -1019,6 +1095,16 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
 
     mirror_free_init(s);
 
+    /*
+     * Start with the fixed settings used before the adaptive tuning, they
+     * are adjusted once the completion of the copies can be measured.
+     */
+    s->max_io_bytes = MAX(s->buf_size / MAX_IN_FLIGHT, MAX_IO_BYTES);
+    s->max_io_bytes = MIN(s->max_io_bytes, mirror_max_io_bytes(s));
+    s->max_in_flight = MAX_IN_FLIGHT;
+    block_job_chunk_tuner_init(&s->tuner, mirror_min_io_bytes(s),
+                               mirror_max_io_bytes(s), s->max_io_bytes);
+
     s->last_pause_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
     if (!s->is_none_mode) {
         ret = mirror_dirty_init(s);
@@ -1069,9 +1155,12 @@ static int coroutine_fn mirror_run(Job *job, Error **errp)
         }
         if (delta < BLOCK_JOB_SLICE_TIME &&
             iostatus == BLOCK_DEVICE_IO_STATUS_OK) {
-            if (s->in_flight >= MAX_IN_FLIGHT || s->buf_free_count == 0 ||
+            if (s->in_flight >= s->max_in_flight || s->buf_free_count == 0 ||
                 (cnt == 0 && s->in_flight > 0)) {
                 trace_mirror_yield(s, cnt, s->buf_free_count, s->in_flight);
+                if (cnt != 0) {
+                    s->saturated = true;
+                }
                 mirror_wait_for_free_in_flight_slot(s);
                 continue;
             } else if (cnt != 0) {
@@ -1214,6 +1303,9 @@ static void coroutine_fn mirror_pause(Job *job)
     MirrorBlockJob *s = container_of(job, MirrorBlockJob, common.job);
 
     mirror_wait_for_all_io(s);
+
+    /* Do not count the time spent paused in the throughput */
+    block_job_chunk_tuner_restart(&s->tuner);
 }
 
 static bool mirror_drained_poll(BlockJob *job)
@@ -1298,6 +1390,15 @@ static void mirror_query(BlockJob *job, BlockJobInfo *info)
     info->u.mirror = (BlockJobInfoMirror) {
         .actively_synced = qatomic_read(&s->actively_synced),
     };
+
+    if (qatomic_read(&s->tuned)) {
+        info->u.mirror.has_in_flight_limit = true;
+        info->u.mirror.in_flight_limit = qatomic_read(&s->max_in_flight);
+        info->u.mirror.has_chunk_size = true;
+        info->u.mirror.chunk_size = qatomic_read(&s->max_io_bytes);
+        info->u.mirror.has_throughput = true;
+        info->u.mirror.throughput = stat64_get(&s->throughput);
+    }
 }
 
 static const BlockJobDriver mirror_job_driver = {
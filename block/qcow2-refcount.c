@@ -23,6 +23,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "block/aio_task.h"
 #include "block/block-io.h"
 #include "qapi/error.h"
 #include "qcow2.h"
@@ -1653,8 +1654,8 @@ fail:
 
 /*
  * Increases the refcount in the given refcount table for the all clusters
- * referenced in the L2 table. While doing so, performs some checks on L2
- * entries.
+ * referenced in the L2 table at @l2_offset, whose contents have been read
+ * into @l2_table. While doing so, performs some checks on L2 entries.
  *
  * Returns the number of errors found by the checks or -errno if an internal
  * error occurred.
@@ -1663,24 +1664,15 @@ static int coroutine_fn GRAPH_RDLOCK
 check_refcounts_l2(BlockDriverState *bs, BdrvCheckResult *res,
                    void **refcount_table,
                    int64_t *refcount_table_size, int64_t l2_offset,
+                   uint64_t *l2_table,
                    int flags, BdrvCheckMode fix, bool active)
 {
     BDRVQcow2State *s = bs->opaque;
     uint64_t l2_entry, l2_bitmap;
     uint64_t next_contiguous_offset = 0;
     int i, ret;
-    size_t l2_size_bytes = s->l2_size * l2_entry_size(s);
-    g_autofree uint64_t *l2_table = g_malloc(l2_size_bytes);
     bool metadata_overlap;
 
-    /* Read L2 table from disk */
-    ret = bdrv_co_pread(bs->file, l2_offset, l2_size_bytes, l2_table, 0);
-    if (ret < 0) {
-        fprintf(stderr, "ERROR: I/O error in check_refcounts_l2\n");
-        res->check_errors++;
-        return ret;
-    }
-
     /* Do the actual checks */
     for (i = 0; i < s->l2_size; i++) {
         uint64_t coffset;
@@ -1851,6 +1843,32 @@ check_refcounts_l2(BlockDriverState *bs, BdrvCheckResult *res,
     return 0;
 }
 
+/*
+ * Number of L2 tables that check_refcounts_l1() reads ahead, with up to
+ * QCOW2_MAX_WORKERS reads in flight.  Large images are dominated by the
+ * latency of these reads, which used to be issued one at a time.
+ */
+#define CHECK_L2_BATCH (2 * QCOW2_MAX_WORKERS)
+
+typedef struct CheckL2ReadTask {
+    AioTask task;
+
+    BlockDriverState *bs;
+    uint64_t l2_offset;
+    uint64_t *l2_table;
+    int *ret;
+} CheckL2ReadTask;
+
+static int coroutine_fn GRAPH_RDLOCK check_l2_read_task_entry(AioTask *task)
+{
+    CheckL2ReadTask *t = container_of(task, CheckL2ReadTask, task);
+    BDRVQcow2State *s = t->bs->opaque;
+
+    *t->ret = bdrv_co_pread(t->bs->file, t->l2_offset,
+                            s->l2_size * l2_entry_size(s), t->l2_table, 0);
+    return *t->ret;
+}
+
 /*
  * Increases the refcount for the L1 table, its L2 tables and all referenced
  * clusters in the given refcount table. While doing so, performs some checks
@@ -1867,9 +1885,11 @@ check_refcounts_l1(BlockDriverState *bs, BdrvCheckResult *res,
 {
     BDRVQcow2State *s = bs->opaque;
     size_t l1_size_bytes = l1_size * L1E_SIZE;
+    size_t l2_size_bytes = s->l2_size * l2_entry_size(s);
     g_autofree uint64_t *l1_table = NULL;
+    g_autofree uint64_t *l2_tables = NULL;
     uint64_t l2_offset;
-    int i, ret;
+    int i, next, ret;
 
     if (!l1_size) {
         return 0;
@@ -1900,41 +1920,86 @@ check_refcounts_l1(BlockDriverState *bs, BdrvCheckResult *res,
         be64_to_cpus(&l1_table[i]);
     }
 
-    /* Do the actual checks */
-    for (i = 0; i < l1_size; i++) {
-        if (!l1_table[i]) {
-            continue;
-        }
+    /*
+     * Do the actual checks.  L2 tables are read in parallel, a batch at a
+     * time, but processed in L1 order so that the refcount table is only
+     * updated by this coroutine and errors are reported in a stable order.
+     */
+    l2_tables = g_malloc(CHECK_L2_BATCH * l2_size_bytes);
 
-        if (l1_table[i] & L1E_RESERVED_MASK) {
-            fprintf(stderr, "ERROR found L1 entry with reserved bits set: "
-                    "%" PRIx64 "\n", l1_table[i]);
-            res->corruptions++;
-        }
+    for (i = 0; i < l1_size; i = next) {
+        AioTaskPool *aio = aio_task_pool_new(QCOW2_MAX_WORKERS);
+        int l2_ret[CHECK_L2_BATCH];
+        int n = 0;
 
-        l2_offset = l1_table[i] & L1E_OFFSET_MASK;
+        for (next = i; next < l1_size && n < CHECK_L2_BATCH; next++) {
+            CheckL2ReadTask *t;
 
-        /* Mark L2 table as used */
-        ret = qcow2_inc_refcounts_imrt(bs, res,
-                                       refcount_table, refcount_table_size,
-                                       l2_offset, s->cluster_size);
-        if (ret < 0) {
-            return ret;
-        }
+            if (!l1_table[next]) {
+                continue;
+            }
 
-        /* L2 tables are cluster aligned */
-        if (offset_into_cluster(s, l2_offset)) {
-            fprintf(stderr, "ERROR l2_offset=%" PRIx64 ": Table is not "
-                "cluster aligned; L1 entry corrupted\n", l2_offset);
-            res->corruptions++;
+            t = g_new(CheckL2ReadTask, 1);
+            *t = (CheckL2ReadTask) {
+                .task.func = check_l2_read_task_entry,
+                .bs = bs,
+                .l2_offset = l1_table[next] & L1E_OFFSET_MASK,
+                .l2_table = l2_tables + n * l2_size_bytes / sizeof(uint64_t),
+                .ret = &l2_ret[n],
+            };
+            aio_task_pool_start_task(aio, &t->task);
+            n++;
         }
 
-        /* Process and check L2 entries */
-        ret = check_refcounts_l2(bs, res, refcount_table,
-                                 refcount_table_size, l2_offset, flags,
-                                 fix, active);
-        if (ret < 0) {
-            return ret;
+        aio_task_pool_wait_all(aio);
+        aio_task_pool_free(aio);
+
+        for (n = 0; i < next; i++) {
+            uint64_t *l2_table;
+
+            if (!l1_table[i]) {
+                continue;
+            }
+
+            l2_table = l2_tables + n * l2_size_bytes / sizeof(uint64_t);
+
+            if (l1_table[i] & L1E_RESERVED_MASK) {
+                fprintf(stderr, "ERROR found L1 entry with reserved bits set: "
+                        "%" PRIx64 "\n", l1_table[i]);
+                res->corruptions++;
+            }
+
+            l2_offset = l1_table[i] & L1E_OFFSET_MASK;
+
+            /* Mark L2 table as used */
+            ret = qcow2_inc_refcounts_imrt(bs, res,
+                                           refcount_table, refcount_table_size,
+                                           l2_offset, s->cluster_size);
+            if (ret < 0) {
+                return ret;
+            }
+
+            /* L2 tables are cluster aligned */
+            if (offset_into_cluster(s, l2_offset)) {
+                fprintf(stderr, "ERROR l2_offset=%" PRIx64 ": Table is not "
+                    "cluster aligned; L1 entry corrupted\n", l2_offset);
+                res->corruptions++;
+            }
+
+            if (l2_ret[n] < 0) {
+                fprintf(stderr, "ERROR: I/O error in check_refcounts_l2\n");
+                res->check_errors++;
+                return l2_ret[n];
+            }
+
+            /* Process and check L2 entries */
+            ret = check_refcounts_l2(bs, res, refcount_table,
+                                     refcount_table_size, l2_offset, l2_table,
+                                     flags, fix, active);
+            if (ret < 0) {
+                return ret;
+            }
+            n++;
         }
     }
 
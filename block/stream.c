@@ -20,16 +20,29 @@
 #include "qemu/ratelimit.h"
 #include "sysemu/block-backend.h"
 #include "block/copy-on-read.h"
+#include "block/aio_task.h"
 
 enum {
     /*
-     * Maximum chunk size to feed to copy-on-read.  This should be
-     * large enough to process multiple clusters in a single call, so
-     * that populating contiguous regions of the image is efficient.
+     * Bounds and initial value of the chunk size to feed to copy-on-read,
+     * which is adapted at run time.  Chunks should be large enough to
+     * process multiple clusters in a single call, so that populating
+     * contiguous regions of the image is efficient.
      */
-    STREAM_CHUNK = 512 * 1024, /* in bytes */
+    STREAM_MIN_CHUNK = 64 * 1024, /* in bytes */
+    STREAM_MAX_CHUNK = 4 * 1024 * 1024, /* in bytes */
+    STREAM_INIT_CHUNK = 2 * 1024 * 1024, /* in bytes */
+    /* Number of copy-on-read requests in flight */
+    STREAM_MAX_WORKERS = 8,
 };
 
+/* A chunk whose population failed */
+typedef struct StreamFailedChunk {
+    int64_t offset;
+    int64_t bytes;
+    int ret;
+} StreamFailedChunk;
+
 typedef struct StreamBlockJob {
     BlockJob common;
     BlockBackend *blk;
@@ -41,8 +54,20 @@ typedef struct StreamBlockJob {
     char *backing_file_str;
     bool backing_mask_protocol;
     bool bs_read_only;
+    /* StreamFailedChunk array, filled by the populate tasks */
+    GArray *failed;
+    AioTaskPool *pool;
+    int in_flight;
+    BlockJobChunkTuner tuner;
 } StreamBlockJob;
 
+typedef struct StreamTask {
+    AioTask task;
+    StreamBlockJob *s;
+    int64_t offset;
+    int64_t bytes;
+} StreamTask;
+
 static int coroutine_fn stream_populate(BlockBackend *blk,
                                         int64_t offset, uint64_t bytes)
 {
@@ -152,10 +177,63 @@ static void stream_clean(Job *job)
     g_free(s->backing_file_str);
 }
 
+static int coroutine_fn stream_task_entry(AioTask *task)
+{
+    StreamTask *t = container_of(task, StreamTask, task);
+    StreamBlockJob *s = t->s;
+    int ret;
+
+    s->in_flight++;
+    ret = stream_populate(s->blk, t->offset, t->bytes);
+    s->in_flight--;
+    if (ret < 0) {
+        /* Let stream_run() apply the error action */
+        StreamFailedChunk chunk = {
+            .offset = t->offset,
+            .bytes = t->bytes,
+            .ret = ret,
+        };
+        g_array_append_val(s->failed, chunk);
+        return 0;
+    }
+
+    /* Publish progress */
+    job_progress_update(&s->common.job, t->bytes);
+    block_job_chunk_done(&s->tuner, t->bytes);
+    return 0;
+}
+
+static void coroutine_fn stream_start_task(StreamBlockJob *s,
+                                           int64_t offset, int64_t bytes)
+{
+    StreamTask *t = g_new(StreamTask, 1);
+
+    *t = (StreamTask) {
+        .task.func = stream_task_entry,
+        .s = s,
+        .offset = offset,
+        .bytes = bytes,
+    };
+    block_job_ratelimit_processed_bytes(&s->common, bytes);
+    aio_task_pool_start_task(s->pool, &t->task);
+}
+
+static void coroutine_fn stream_pause(Job *job)
+{
+    StreamBlockJob *s = container_of(job, StreamBlockJob, common.job);
+
+    /* No copy-on-read may be in flight while the job is paused */
+    if (s->pool) {
+        aio_task_pool_wait_all(s->pool);
+        block_job_chunk_tuner_restart(&s->tuner);
+    }
+}
+
 static int coroutine_fn stream_run(Job *job, Error **errp)
 {
     StreamBlockJob *s = container_of(job, StreamBlockJob, common.job);
     BlockDriverState *unfiltered_bs;
+    StreamFailedChunk retry = { .bytes = 0 };
     int64_t len;
     int64_t offset = 0;
     int error = 0;
@@ -175,22 +253,75 @@ static int coroutine_fn stream_run(Job *job, Error **errp)
     }
     job_progress_set_remaining(&s->common.job, len);
 
-    for ( ; offset < len; offset += n) {
+    /*
+     * Areas to copy are populated by up to STREAM_MAX_WORKERS tasks in
+     * parallel; failed chunks are handed back here so that the error action
+     * is applied from the job coroutine.
+     */
+    s->failed = g_array_new(false, false, sizeof(StreamFailedChunk));
+    s->pool = aio_task_pool_new(STREAM_MAX_WORKERS);
+    block_job_chunk_tuner_init(&s->tuner, STREAM_MIN_CHUNK, STREAM_MAX_CHUNK,
+                               STREAM_INIT_CHUNK);
+
+    while (true) {
+        BlockErrorAction action;
         bool copy;
         int ret;
 
-        /* Note that even when no rate limit is applied we need to yield
-         * with no pending I/O here so that bdrv_drain_all() returns.
+        /*
+         * Even when no rate limit is applied we need to yield here so that
+         * the job can be paused and bdrv_drain_all() returns.
          */
         block_job_ratelimit_sleep(&s->common);
         if (job_is_cancelled(&s->common.job)) {
             break;
         }
 
+        /* Retry a failed chunk only after the job had a chance to pause */
+        if (retry.bytes) {
+            stream_start_task(s, retry.offset, retry.bytes);
+            retry.bytes = 0;
+            continue;
+        }
+
+        if (offset >= len && !s->failed->len) {
+            aio_task_pool_wait_all(s->pool);
+            if (!s->failed->len) {
+                break;
+            }
+        }
+
+        if (s->failed->len) {
+            StreamFailedChunk chunk =
+                g_array_index(s->failed, StreamFailedChunk, 0);
+
+            g_array_remove_index(s->failed, 0);
+            action = block_job_error_action(&s->common, s->on_error, true,
+                                            -chunk.ret);
+            if (action == BLOCK_ERROR_ACTION_STOP) {
+                retry = chunk;
+                continue;
+            }
+            if (error == 0) {
+                error = chunk.ret;
+            }
+            if (action == BLOCK_ERROR_ACTION_REPORT) {
+                break;
+            }
+            /* Ignored, skip the chunk */
+            job_progress_update(&s->common.job, chunk.bytes);
+            continue;
+        }
+
         copy = false;
 
         WITH_GRAPH_RDLOCK_GUARD() {
-            ret = bdrv_co_is_allocated(unfiltered_bs, offset, STREAM_CHUNK, &n);
+            /*
+             * Query the whole remaining range so that areas allocated in the
+             * top are skipped in a single step.
+             */
+            ret = bdrv_co_is_allocated(unfiltered_bs, offset, len - offset,
+                                       &n);
             if (ret == 1) {
                 /* Allocated in the top, no need to copy.  */
             } else if (ret >= 0) {
@@ -210,30 +341,43 @@ static int coroutine_fn stream_run(Job *job, Error **errp)
             }
         }
         trace_stream_one_iteration(s, offset, n, ret);
-        if (copy) {
-            ret = stream_populate(s->blk, offset, n);
-        }
         if (ret < 0) {
-            BlockErrorAction action =
-                block_job_error_action(&s->common, s->on_error, true, -ret);
-            if (action == BLOCK_ERROR_ACTION_STOP) {
-                n = 0;
-                continue;
-            }
-            if (error == 0) {
-                error = ret;
-            }
+            action = block_job_error_action(&s->common, s->on_error, true,
+                                            -ret);
             if (action == BLOCK_ERROR_ACTION_REPORT) {
+                if (error == 0) {
+                    error = ret;
+                }
                 break;
             }
+            /*
+             * Nothing is known about the range, so it can't be skipped.
+             * Like mirror does for its dirty areas, query it again once the
+             * job had a chance to pause or be cancelled.
+             */
+            continue;
+        } else if (copy) {
+            bool saturated = s->in_flight == STREAM_MAX_WORKERS;
+
+            n = MIN(n, block_job_chunk_size(&s->common, &s->tuner, saturated));
+            stream_start_task(s, offset, n);
+        } else {
+            /* Publish progress */
+            job_progress_update(&s->common.job, n);
         }
+        offset += n;
+    }
 
-        /* Publish progress */
-        job_progress_update(&s->common.job, n);
-        if (copy) {
-            block_job_ratelimit_processed_bytes(&s->common, n);
-        }
+    aio_task_pool_wait_all(s->pool);
+    aio_task_pool_free(s->pool);
+    s->pool = NULL;
+
+    /* Errors of the last tasks are reported even if the job was cancelled */
+    if (s->failed->len && error == 0) {
+        error = g_array_index(s->failed, StreamFailedChunk, 0).ret;
     }
+    g_array_free(s->failed, true);
+    s->failed = NULL;
 
     /* Do not remove the backing file if an error was there but ignored. */
     return error;
@@ -245,6 +389,7 @@ static const BlockJobDriver stream_job_driver = {
         .job_type      = JOB_TYPE_STREAM,
         .free          = block_job_free,
         .run           = stream_run,
+        .pause         = stream_pause,
         .prepare       = stream_prepare,
         .clean         = stream_clean,
         .user_resume   = block_job_user_resume,
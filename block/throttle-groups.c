@@ -62,6 +62,16 @@ static void timer_cb(ThrottleGroupMember *tgm, ThrottleDirection direction);
  * blk_set_aio_context()). Therefore in this file a thread will
  * access some other ThrottleGroupMember's timers only after verifying that
  * that ThrottleGroupMember has throttled requests in the queue.
+ *
+ * Taking the lock for every request makes members running in different
+ * threads contend with each other, so each member can also keep a small
+ * credit of bytes and operations in ThrottleGroupMember.credit.  The
+ * credit is accounted in the group when it is handed out, under the lock,
+ * and requests that fit in it skip the lock entirely as long as no other
+ * request in the group is waiting for its turn.  In order not to hurt the
+ * round-robin fairness the credit is only refilled when no member has
+ * throttled requests, and it is kept to about one millisecond worth of the
+ * configured limits.
  */
 struct ThrottleGroup {
     Object parent_obj;
@@ -70,11 +80,13 @@ struct ThrottleGroup {
     bool is_initialized;
     char *name; /* This is constant during the lifetime of the group */
 
-    QemuMutex lock; /* This lock protects the following four fields */
+    QemuMutex lock; /* This lock protects the following five fields */
     ThrottleState ts;
     QLIST_HEAD(, ThrottleGroupMember) head;
     ThrottleGroupMember *tokens[THROTTLE_MAX];
+    /* These two are also read without the lock by the credit fast path */
     bool any_timer_armed[THROTTLE_MAX];
+    unsigned pending_reqs[THROTTLE_MAX];
     QEMUClockType clock_type;
 
     /* This field is protected by the global QEMU mutex */
@@ -286,7 +298,7 @@ static bool throttle_group_schedule_timer(ThrottleGroupMember *tgm,
     /* If a timer just got armed, set tgm as the current token */
     if (must_wait) {
         tg->tokens[direction] = tgm;
-        tg->any_timer_armed[direction] = true;
+        qatomic_set(&tg->any_timer_armed[direction], true);
     }
 
     return must_wait;
@@ -310,6 +322,179 @@ static bool coroutine_fn throttle_group_co_restart_queue(ThrottleGroupMember *tg
     return ret;
 }
 
+/*
+ * A member's credit packs the number of bytes in the upper bits and the
+ * number of operations in the lower bits, so that both can be consumed
+ * with a single atomic operation.
+ */
+#define TG_CREDIT_OPS_BITS      24
+#define TG_CREDIT_OPS_MASK      ((1ULL << TG_CREDIT_OPS_BITS) - 1)
+#define TG_CREDIT_BYTES_MAX     (UINT64_MAX >> TG_CREDIT_OPS_BITS)
+#define TG_CREDIT(bytes, ops)   (((uint64_t)(bytes) << TG_CREDIT_OPS_BITS) | \
+                                 (ops))
+#define TG_CREDIT_BYTES(c)      ((c) >> TG_CREDIT_OPS_BITS)
+#define TG_CREDIT_OPS(c)        ((c) & TG_CREDIT_OPS_MASK)
+
+/* Maximum number of operations handed out at once */
+#define TG_CREDIT_OPS_MAX       64
+
+/* The credit is 1/TG_CREDIT_SLICES of the average limits per second */
+#define TG_CREDIT_SLICES        1000
+
+/* Compute the credit handed out to a member, or 0 if the configuration
+ * does not allow one.
+ *
+ * @cfg:       the group configuration
+ * @direction: the ThrottleDirection
+ * @ret:       the packed credit
+ */
+static uint64_t throttle_group_credit_size(ThrottleConfig *cfg,
+                                           ThrottleDirection direction)
+{
+    static const BucketType bucket_types_size[THROTTLE_MAX][2] = {
+        { THROTTLE_BPS_TOTAL, THROTTLE_BPS_READ },
+        { THROTTLE_BPS_TOTAL, THROTTLE_BPS_WRITE }
+    };
+    static const BucketType bucket_types_units[THROTTLE_MAX][2] = {
+        { THROTTLE_OPS_TOTAL, THROTTLE_OPS_READ },
+        { THROTTLE_OPS_TOTAL, THROTTLE_OPS_WRITE }
+    };
+    uint64_t bytes = TG_CREDIT_BYTES_MAX;
+    uint64_t ops = TG_CREDIT_OPS_MAX;
+    unsigned i;
+
+    /* Requests count as a single operation only without iops-size */
+    if (cfg->op_size) {
+        return 0;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(bucket_types_size[THROTTLE_READ]); i++) {
+        uint64_t avg = cfg->buckets[bucket_types_size[direction][i]].avg;
+        if (avg) {
+            bytes = MIN(bytes, avg / TG_CREDIT_SLICES);
+        }
+        avg = cfg->buckets[bucket_types_units[direction][i]].avg;
+        if (avg) {
+            ops = MIN(ops, avg / TG_CREDIT_SLICES);
+        }
+    }
+
+    if (!bytes || !ops) {
+        return 0;
+    }
+    return TG_CREDIT(bytes, ops);
+}
+
+/* Give the unused credit of a member back to the group.
+ *
+ * This assumes that tg->lock is held.
+ *
+ * @tgm:       the ThrottleGroupMember
+ * @direction: the ThrottleDirection
+ */
+static void throttle_group_return_credit(ThrottleGroupMember *tgm,
+                                         ThrottleDirection direction)
+{
+#ifdef CONFIG_ATOMIC64
+    uint64_t credit = qatomic_xchg(&tgm->credit[direction], 0);
+
+    if (credit) {
+        throttle_account_units(tgm->throttle_state, direction,
+                               -(double)TG_CREDIT_BYTES(credit),
+                               -(double)TG_CREDIT_OPS(credit));
+    }
+#endif
+}
+
+/* Give the unused credit of all members back to the group.
+ *
+ * This assumes that tg->lock is held.
+ */
+static void throttle_group_return_all_credit(ThrottleGroup *tg)
+{
+    ThrottleGroupMember *tgm;
+    ThrottleDirection dir;
+
+    QLIST_FOREACH(tgm, &tg->head, round_robin) {
+        for (dir = THROTTLE_READ; dir < THROTTLE_MAX; dir++) {
+            throttle_group_return_credit(tgm, dir);
+        }
+    }
+}
+
+/* Hand out a new credit to a member if nobody else is waiting and the
+ * limits have not been reached yet.
+ *
+ * This assumes that tg->lock is held.
+ *
+ * @tgm:       the ThrottleGroupMember
+ * @direction: the ThrottleDirection
+ */
+static void throttle_group_refill_credit(ThrottleGroupMember *tgm,
+                                         ThrottleDirection direction)
+{
+#ifdef CONFIG_ATOMIC64
+    ThrottleState *ts = tgm->throttle_state;
+    ThrottleGroup *tg = container_of(ts, ThrottleGroup, ts);
+    uint64_t credit;
+
+    throttle_group_return_credit(tgm, direction);
+
+    if (qatomic_read(&tgm->io_limits_disabled) ||
+        tg->any_timer_armed[direction] || tg->pending_reqs[direction]) {
+        return;
+    }
+
+    credit = throttle_group_credit_size(&ts->cfg, direction);
+    if (!credit || throttle_must_wait(ts, tg->clock_type, direction)) {
+        return;
+    }
+
+    throttle_account_units(ts, direction, TG_CREDIT_BYTES(credit),
+                           TG_CREDIT_OPS(credit));
+    qatomic_set(&tgm->credit[direction], credit);
+#endif
+}
+
+/* Try to run an I/O request using the member's credit, without taking
+ * tg->lock.
+ *
+ * @tgm:       the ThrottleGroupMember
+ * @bytes:     the number of bytes for this I/O
+ * @direction: the ThrottleDirection
+ * @ret:       whether the request can be executed right away
+ */
+static bool throttle_group_use_credit(ThrottleGroupMember *tgm,
+                                      int64_t bytes,
+                                      ThrottleDirection direction)
+{
+#ifdef CONFIG_ATOMIC64
+    ThrottleGroup *tg = container_of(tgm->throttle_state, ThrottleGroup, ts);
+    uint64_t old, new, cur;
+
+    /* Leave the way to requests that are waiting for their turn */
+    if (qatomic_read(&tg->any_timer_armed[direction]) ||
+        qatomic_read(&tg->pending_reqs[direction])) {
+        return false;
+    }
+
+    old = qatomic_read(&tgm->credit[direction]);
+    for (;;) {
+        if (TG_CREDIT_BYTES(old) < (uint64_t)bytes || !TG_CREDIT_OPS(old)) {
+            return false;
+        }
+        new = old - TG_CREDIT(bytes, 1);
+        cur = qatomic_cmpxchg(&tgm->credit[direction], old, new);
+        if (cur == old) {
+            return true;
+        }
+        old = cur;
+    }
+#else
+    return false;
+#endif
+}
+
 /* Look for the next pending I/O request and schedule it.
  *
  * This assumes that tg->lock is held.
@@ -344,7 +529,7 @@ static void coroutine_mixed_fn schedule_next_request(ThrottleGroupMember *tgm,
             ThrottleTimers *tt = &token->throttle_timers;
             int64_t now = qemu_clock_get_ns(tg->clock_type);
             timer_mod(tt->timers[direction], now);
-            tg->any_timer_armed[direction] = true;
+            qatomic_set(&tg->any_timer_armed[direction], true);
         }
         tg->tokens[direction] = token;
     }
@@ -369,6 +554,10 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
     assert(bytes >= 0);
     assert(direction < THROTTLE_MAX);
 
+    if (throttle_group_use_credit(tgm, bytes, direction)) {
+        return;
+    }
+
     qemu_mutex_lock(&tg->lock);
 
     /* First we check if this I/O has to be throttled. */
@@ -378,12 +567,16 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
     /* Wait if there's a timer set or queued requests of this type */
     if (must_wait || tgm->pending_reqs[direction]) {
         tgm->pending_reqs[direction]++;
+        qatomic_set(&tg->pending_reqs[direction],
+                    tg->pending_reqs[direction] + 1);
         qemu_mutex_unlock(&tg->lock);
         qemu_co_mutex_lock(&tgm->throttled_reqs_lock);
         qemu_co_queue_wait(&tgm->throttled_reqs[direction],
                            &tgm->throttled_reqs_lock);
         qemu_co_mutex_unlock(&tgm->throttled_reqs_lock);
         qemu_mutex_lock(&tg->lock);
+        qatomic_set(&tg->pending_reqs[direction],
+                    tg->pending_reqs[direction] - 1);
         tgm->pending_reqs[direction]--;
     }
 
@@ -393,6 +586,9 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
     /* Schedule the next request */
     schedule_next_request(tgm, direction);
 
+    /* Let the following requests skip the lock if possible */
+    throttle_group_refill_credit(tgm, direction);
+
     qemu_mutex_unlock(&tg->lock);
 }
 
@@ -477,6 +673,7 @@ void throttle_group_config(ThrottleGroupMember *tgm, ThrottleConfig *cfg)
     ThrottleState *ts = tgm->throttle_state;
     ThrottleGroup *tg = container_of(ts, ThrottleGroup, ts);
     qemu_mutex_lock(&tg->lock);
+    throttle_group_return_all_credit(tg);
     throttle_config(ts, tg->clock_type, cfg);
     qemu_mutex_unlock(&tg->lock);
 
@@ -512,7 +709,7 @@ static void timer_cb(ThrottleGroupMember *tgm, ThrottleDirection direction)
 
     /* The timer has just been fired, so we can update the flag */
     qemu_mutex_lock(&tg->lock);
-    tg->any_timer_armed[direction] = false;
+    qatomic_set(&tg->any_timer_armed[direction], false);
     qemu_mutex_unlock(&tg->lock);
 
     /* Run the request that was waiting for this timer */
@@ -559,6 +756,7 @@ void throttle_group_register_tgm(ThrottleGroupMember *tgm,
             tg->tokens[dir] = tgm;
         }
         qemu_co_queue_init(&tgm->throttled_reqs[dir]);
+        qatomic_set(&tgm->credit[dir], 0);
     }
 
     QLIST_INSERT_HEAD(&tg->head, tgm, round_robin);
@@ -602,6 +800,7 @@ void throttle_group_unregister_tgm(ThrottleGroupMember *tgm)
             assert(tgm->pending_reqs[dir] == 0);
             assert(qemu_co_queue_empty(&tgm->throttled_reqs[dir]));
             assert(!timer_pending(tgm->throttle_timers.timers[dir]));
+            throttle_group_return_credit(tgm, dir);
             if (tg->tokens[dir] == tgm) {
                 token = throttle_group_next_tgm(tgm);
                 /* Take care of the case where this is the last tgm in the group */
@@ -645,7 +844,7 @@ void throttle_group_detach_aio_context(ThrottleGroupMember *tgm)
     WITH_QEMU_LOCK_GUARD(&tg->lock) {
         for (dir = THROTTLE_READ; dir < THROTTLE_MAX; dir++) {
             if (timer_pending(tt->timers[dir])) {
-                tg->any_timer_armed[dir] = false;
+                qatomic_set(&tg->any_timer_armed[dir], false);
                 schedule_next_request(tgm, dir);
             }
         }
@@ -902,6 +1101,7 @@ static void throttle_group_set_limits(Object *obj, Visitor *v,
     if (local_err) {
         goto unlock;
     }
+    throttle_group_return_all_credit(tg);
     throttle_config(&tg->ts, tg->clock_type, &cfg);
 
 unlock:
@@ -356,6 +356,121 @@ void block_job_ratelimit_sleep(BlockJob *job)
     } while (delay_ns && !job_is_cancelled(&job->job));
 }
 
+/* Windows to wait after the direction of the chunk tuning was reversed */
+#define BLOCK_JOB_TUNE_HOLD_WINDOWS 10
+
+void block_job_chunk_tuner_init(BlockJobChunkTuner *t, int64_t min_chunk,
+                                int64_t max_chunk, int64_t chunk)
+{
+    *t = (BlockJobChunkTuner) {
+        .min_chunk = min_chunk,
+        .max_chunk = max_chunk,
+        .chunk = chunk,
+        .grow = true,
+    };
+    block_job_chunk_tuner_restart(t);
+}
+
+void block_job_chunk_tuner_restart(BlockJobChunkTuner *t)
+{
+    t->start_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    t->bytes = 0;
+    t->saturated = false;
+}
+
+void block_job_chunk_done(BlockJobChunkTuner *t, int64_t bytes)
+{
+    t->bytes += bytes;
+}
+
+static bool block_job_chunk_step(BlockJobChunkTuner *t)
+{
+    int64_t chunk = t->grow ? t->chunk * 2 : t->chunk / 2;
+
+    if (chunk < t->min_chunk || chunk > t->max_chunk) {
+        return false;
+    }
+    t->chunk = chunk;
+    return true;
+}
+
+/*
+ * Called at the end of each window in which the job was saturated.  The
+ * throughput of the window is compared with that of the previous one, and
+ * the chunk size is moved one step at a time in the direction that
+ * improves it:
+ *
+ * - a step that makes things more than 5% worse is undone and the
+ *   direction is reversed;
+ * - a step that does not improve things by at least 5% is kept, but the
+ *   direction is reversed;
+ *
+ * and in both cases no further step is tried for a few windows, so that
+ * the size does not keep oscillating around the optimum.
+ */
+static void block_job_chunk_tune(BlockJob *job, BlockJobChunkTuner *t,
+                                 uint64_t bw)
+{
+    trace_block_job_chunk_tune(job, bw, t->chunk);
+
+    t->bw = bw;
+    if (t->changed && bw * 20 < t->last_bw * 19) {
+        t->grow = !t->grow;
+        block_job_chunk_step(t);
+        t->changed = false;
+        t->hold = BLOCK_JOB_TUNE_HOLD_WINDOWS;
+    } else if (t->changed && bw * 20 < t->last_bw * 21) {
+        t->last_bw = bw;
+        t->grow = !t->grow;
+        t->changed = false;
+        t->hold = BLOCK_JOB_TUNE_HOLD_WINDOWS;
+    } else if (t->hold) {
+        t->hold--;
+    } else {
+        t->last_bw = bw;
+        t->changed = block_job_chunk_step(t);
+        if (!t->changed) {
+            t->grow = !t->grow;
+        }
+    }
+}
+
+int64_t block_job_chunk_size(BlockJob *job, BlockJobChunkTuner *t,
+                             bool saturated)
+{
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    int64_t elapsed = now - t->start_ns;
+    int64_t speed;
+
+    WITH_JOB_LOCK_GUARD() {
+        speed = job->speed;
+    }
+
+    t->saturated |= saturated;
+    if (elapsed >= BLOCK_JOB_SLICE_TIME) {
+        /*
+         * Otherwise the job is limited by something else than the request
+         * size (rate limit, unallocated areas, ...)
+         */
+        if (t->saturated && !speed) {
+            block_job_chunk_tune(job, t, (double)t->bytes *
+                                 NANOSECONDS_PER_SECOND / elapsed);
+        } else {
+            t->changed = false;
+        }
+        block_job_chunk_tuner_restart(t);
+    }
+
+    if (speed) {
+        /* No more than the limit allows per time slice */
+        int64_t slice_bytes =
+            speed / (NANOSECONDS_PER_SECOND / BLOCK_JOB_SLICE_TIME);
+
+        return MAX(t->min_chunk, MIN(t->chunk, slice_bytes));
+    }
+    return t->chunk;
+}
+
 BlockJobInfo *block_job_query_locked(BlockJob *job, Error **errp)
 {
     BlockJobInfo *info;
@@ -33,6 +33,18 @@
 
 #include <gnutls/x509.h>
 
+#ifdef CONFIG_KTLS
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
+
 
 struct QCryptoTLSSession {
     QCryptoTLSCreds *creds;
@@ -101,6 +113,7 @@ qcrypto_tls_session_new(QCryptoTLSCreds *creds,
                         Error **errp)
 {
     QCryptoTLSSession *session;
+    unsigned int flags = 0;
     int ret;
 
     session = g_new0(QCryptoTLSSession, 1);
@@ -122,10 +135,20 @@ qcrypto_tls_session_new(QCryptoTLSCreds *creds,
         goto error;
     }
 
+#ifdef CONFIG_KTLS
+    /*
+     * Once the kernel owns the record layer, post-handshake messages can
+     * no longer be processed, so do not send or ask for session tickets.
+     */
+    if (creds->ktls) {
+        flags |= GNUTLS_NO_TICKETS;
+    }
+#endif
+
     if (endpoint == QCRYPTO_TLS_CREDS_ENDPOINT_SERVER) {
-        ret = gnutls_init(&session->handle, GNUTLS_SERVER);
+        ret = gnutls_init(&session->handle, GNUTLS_SERVER | flags);
     } else {
-        ret = gnutls_init(&session->handle, GNUTLS_CLIENT);
+        ret = gnutls_init(&session->handle, GNUTLS_CLIENT | flags);
     }
     if (ret < 0) {
         error_setg(errp, "Cannot initialize TLS session: %s",
@@ -562,6 +585,195 @@ qcrypto_tls_session_get_peer_name(QCryptoTLSSession *session)
 }
 
 
+#ifdef CONFIG_KTLS
+
+typedef union {
+    struct tls_crypto_info info;
+    struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+#ifdef TLS_CIPHER_AES_GCM_256
+    struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+#endif
+} QCryptoTLSSessionKTLSInfo;
+
+/*
+ * With AES-GCM the 12 byte nonce is a 4 byte salt followed by 8 bytes
+ * that TLS 1.2 sends explicitly, starting from the sequence number, and
+ * that TLS 1.3 derives from the key schedule.  Both key sizes share the
+ * same salt, IV and sequence number sizes.
+ */
+QEMU_BUILD_BUG_ON(TLS_CIPHER_AES_GCM_128_SALT_SIZE != 4 ||
+                  TLS_CIPHER_AES_GCM_128_IV_SIZE != 8 ||
+                  TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE != 8);
+
+static bool
+qcrypto_tls_session_set_ktls_aes_gcm(gnutls_protocol_t version,
+                                     const gnutls_datum_t *iv,
+                                     const gnutls_datum_t *key,
+                                     const unsigned char *seq,
+                                     unsigned char *info_salt,
+                                     unsigned char *info_iv,
+                                     unsigned char *info_key,
+                                     size_t key_size,
+                                     unsigned char *info_rec_seq)
+{
+    bool tls12 = version == GNUTLS_TLS1_2;
+
+    if (key->size != key_size || iv->size < (tls12 ? 4 : 12)) {
+        return false;
+    }
+
+    memcpy(info_salt, iv->data, 4);
+    memcpy(info_iv, tls12 ? seq : iv->data + 4, 8);
+    memcpy(info_key, key->data, key_size);
+    memcpy(info_rec_seq, seq, 8);
+    return true;
+}
+
+/*
+ * Fill @info with the parameters for one direction of @session.
+ *
+ * Returns: the size of the structure to pass to setsockopt(), or 0
+ * if the kernel does not support the negotiated version and cipher.
+ */
+static socklen_t
+qcrypto_tls_session_get_ktls_info(QCryptoTLSSession *session,
+                                  bool read,
+                                  QCryptoTLSSessionKTLSInfo *info)
+{
+    gnutls_protocol_t version = gnutls_protocol_get_version(session->handle);
+    gnutls_datum_t iv, key;
+    unsigned char seq[8];
+
+    memset(info, 0, sizeof(*info));
+
+    switch (version) {
+    case GNUTLS_TLS1_2:
+        info->info.version = TLS_1_2_VERSION;
+        break;
+#if defined(TLS_1_3_VERSION) && GNUTLS_VERSION_NUMBER >= 0x030603
+    case GNUTLS_TLS1_3:
+        info->info.version = TLS_1_3_VERSION;
+        break;
+#endif
+    default:
+        return 0;
+    }
+
+    if (gnutls_record_get_state(session->handle, read,
+                                NULL, &iv, &key, seq) < 0) {
+        return 0;
+    }
+
+    switch (gnutls_cipher_get(session->handle)) {
+    case GNUTLS_CIPHER_AES_128_GCM: {
+        struct tls12_crypto_info_aes_gcm_128 *c = &info->aes_gcm_128;
+
+        c->info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        if (!qcrypto_tls_session_set_ktls_aes_gcm(
+                version, &iv, &key, seq, c->salt, c->iv,
+                c->key, sizeof(c->key), c->rec_seq)) {
+            return 0;
+        }
+        return sizeof(*c);
+    }
+#ifdef TLS_CIPHER_AES_GCM_256
+    case GNUTLS_CIPHER_AES_256_GCM: {
+        struct tls12_crypto_info_aes_gcm_256 *c = &info->aes_gcm_256;
+
+        c->info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        if (!qcrypto_tls_session_set_ktls_aes_gcm(
+                version, &iv, &key, seq, c->salt, c->iv,
+                c->key, sizeof(c->key), c->rec_seq)) {
+            return 0;
+        }
+        return sizeof(*c);
+    }
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case GNUTLS_CIPHER_CHACHA20_POLY1305: {
+        struct tls12_crypto_info_chacha20_poly1305 *c =
+            &info->chacha20_poly1305;
+
+        if (key.size != TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE ||
+            iv.size != TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE) {
+            return 0;
+        }
+        c->info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        memcpy(c->iv, iv.data, TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE);
+        memcpy(c->key, key.data, TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE);
+        memcpy(c->rec_seq, seq, TLS_CIPHER_CHACHA20_POLY1305_REC_SEQ_SIZE);
+        return sizeof(*c);
+    }
+#endif
+    default:
+        return 0;
+    }
+}
+
+
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *session,
+                                int fd)
+{
+    QCryptoTLSSessionKTLSInfo info;
+    socklen_t len;
+    int ret = 0;
+
+    if (!session->creds->ktls || !session->handshakeComplete) {
+        return 0;
+    }
+
+    /* Data that gnutls has already decrypted would be lost */
+    if (gnutls_record_check_pending(session->handle)) {
+        trace_qcrypto_tls_session_ktls_unavailable(session, "pending data");
+        return 0;
+    }
+
+    len = qcrypto_tls_session_get_ktls_info(session, false, &info);
+    if (!len) {
+        trace_qcrypto_tls_session_ktls_unavailable(session,
+                                                   "unsupported cipher");
+        goto out;
+    }
+
+    if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+        trace_qcrypto_tls_session_ktls_unavailable(session, strerror(errno));
+        goto out;
+    }
+
+    /*
+     * Each direction is independent: if only one can be offloaded,
+     * gnutls keeps handling the other one.
+     */
+    if (setsockopt(fd, SOL_TLS, TLS_TX, &info, len) == 0) {
+        ret |= QCRYPTO_TLS_KTLS_TX;
+    }
+    len = qcrypto_tls_session_get_ktls_info(session, true, &info);
+    if (len && setsockopt(fd, SOL_TLS, TLS_RX, &info, len) == 0) {
+        ret |= QCRYPTO_TLS_KTLS_RX;
+    }
+
+ out:
+    explicit_bzero(&info, sizeof(info));
+    trace_qcrypto_tls_session_enable_ktls(session, fd, ret);
+    return ret;
+}
+
+#else /* ! CONFIG_KTLS */
+
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *session G_GNUC_UNUSED,
+                                int fd G_GNUC_UNUSED)
+{
+    return 0;
+}
+
+#endif /* ! CONFIG_KTLS */
+
+
 #else /* ! CONFIG_GNUTLS */
 
 
@@ -660,4 +872,12 @@ qcrypto_tls_session_get_peer_name(QCryptoTLSSession *sess)
     return NULL;
 }
 
+
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *sess G_GNUC_UNUSED,
+                                int fd G_GNUC_UNUSED)
+{
+    return 0;
+}
+
 #endif
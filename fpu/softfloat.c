@@ -339,6 +339,43 @@ static inline bool f64_is_inf(union_float64 a)
     return float64_is_infinity(a.s);
 }
 
+/*
+ * Hardfloat rounding of a zero or normal value to an integer, for the
+ * float-to-int conversions.  Only truncation and round-to-nearest-even
+ * are handled; as for the arithmetic ops, the host FPU is assumed to be
+ * in its default round-to-nearest mode.  The result is only used when it
+ * lies in [@lo, @hi), so the one flag that can be raised is inexact, and
+ * that is computed exactly by comparing the rounded value with the input.
+ * Returns false if the caller must take the soft path.
+ */
+static inline bool hard_round_to_int(double h, FloatRoundMode rmode,
+                                     double lo, double hi, double *r,
+                                     float_status *s)
+{
+    if (QEMU_NO_HARDFLOAT) {
+        return false;
+    }
+
+    switch (rmode) {
+    case float_round_nearest_even:
+        *r = rint(h);
+        break;
+    case float_round_to_zero:
+        *r = trunc(h);
+        break;
+    default:
+        return false;
+    }
+
+    if (unlikely(!(*r >= lo && *r < hi))) {
+        return false;
+    }
+    if (*r != h) {
+        float_raise(float_flag_inexact, s);
+    }
+    return true;
+}
+
 static inline float32
 float32_gen2(float32 xa, float32 xb, float_status *s,
              hard_f32_op2_fn hard, soft_f32_op2_fn soft,
@@ -2828,6 +2865,25 @@ float16 float64_to_float16(float64 a, bool ieee, float_status *s)
 float32 float64_to_float32(float64 a, float_status *s)
 {
     FloatParts64 p;
+    union_float64 ud;
+    union_float32 uf;
+
+    /*
+     * Narrowing a normal value to a result that is normal but not the
+     * smallest normal can only raise inexact, which is exact to compute.
+     * Overflow and possible underflow are left to the soft path.
+     */
+    if (!QEMU_NO_HARDFLOAT && likely(float64_is_normal(a)) &&
+        s->float_rounding_mode == float_round_nearest_even) {
+        ud.s = a;
+        uf.h = ud.h;
+        if (likely(float32_is_normal(uf.s) && fabsf(uf.h) > FLT_MIN)) {
+            if (uf.h != ud.h) {
+                float_raise(float_flag_inexact, s);
+            }
+            return uf.s;
+        }
+    }
 
     float64_unpack_canonical(&p, a, s);
     parts_float_to_float(&p, s);
@@ -3092,6 +3148,14 @@ int32_t float32_to_int32_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    union_float32 ua;
+    double r;
+
+    ua.s = a;
+    if (likely(scale == 0) && float32_is_zero_or_normal(a) &&
+        hard_round_to_int(ua.h, rmode, -0x1p31, 0x1p31, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT32_MIN, INT32_MAX, s);
@@ -3101,6 +3165,14 @@ int64_t float32_to_int64_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    union_float32 ua;
+    double r;
+
+    ua.s = a;
+    if (likely(scale == 0) && float32_is_zero_or_normal(a) &&
+        hard_round_to_int(ua.h, rmode, -0x1p63, 0x1p63, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT64_MIN, INT64_MAX, s);
@@ -3119,6 +3191,14 @@ int32_t float64_to_int32_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    union_float64 ua;
+    double r;
+
+    ua.s = a;
+    if (likely(scale == 0) && float64_is_zero_or_normal(a) &&
+        hard_round_to_int(ua.h, rmode, -0x1p31, 0x1p31, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT32_MIN, INT32_MAX, s);
@@ -3128,6 +3208,14 @@ int64_t float64_to_int64_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                 float_status *s)
 {
     FloatParts64 p;
+    union_float64 ua;
+    double r;
+
+    ua.s = a;
+    if (likely(scale == 0) && float64_is_zero_or_normal(a) &&
+        hard_round_to_int(ua.h, rmode, -0x1p63, 0x1p63, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT64_MIN, INT64_MAX, s);
@@ -3519,6 +3607,14 @@ uint32_t float32_to_uint32_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    union_float32 ua;
+    double r;
+
+    ua.s = a;
+    if (likely(scale == 0) && float32_is_zero_or_normal(a) &&
+        hard_round_to_int(ua.h, rmode, 0.0, 0x1p32, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT32_MAX, s);
@@ -3528,6 +3624,14 @@ uint64_t float32_to_uint64_scalbn(float32 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    union_float32 ua;
+    double r;
+
+    ua.s = a;
+    if (likely(scale == 0) && float32_is_zero_or_normal(a) &&
+        hard_round_to_int(ua.h, rmode, 0.0, 0x1p64, &r, s)) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT64_MAX, s);
@@ -3546,6 +3650,14 @@ uint32_t float64_to_uint32_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    union_float64 ua;
+    double r;
+
+    ua.s = a;
+    if (likely(scale == 0) && float64_is_zero_or_normal(a) &&
+        hard_round_to_int(ua.h, rmode, 0.0, 0x1p32, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT32_MAX, s);
@@ -3555,6 +3667,14 @@ uint64_t float64_to_uint64_scalbn(float64 a, FloatRoundMode rmode, int scale,
                                   float_status *s)
 {
     FloatParts64 p;
+    union_float64 ua;
+    double r;
+
+    ua.s = a;
+    if (likely(scale == 0) && float64_is_zero_or_normal(a) &&
+        hard_round_to_int(ua.h, rmode, 0.0, 0x1p64, &r, s)) {
+        return r;
+    }
 
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT64_MAX, s);
@@ -4282,6 +4402,28 @@ static bfloat16 bfloat16_minmax(bfloat16 a, bfloat16 b,
 static float32 float32_minmax(float32 a, float32 b, float_status *s, int flags)
 {
     FloatParts64 pa, pb, *pr;
+    union_float32 ua, ub;
+
+    ua.s = a;
+    ub.s = b;
+
+    /*
+     * Between zeros and normals no flag can be raised and the result is
+     * one of the inputs, unchanged.  Only the magnitude variants and
+     * comparing zeros of opposite sign need the soft path.
+     */
+    if (!QEMU_NO_HARDFLOAT && !(flags & minmax_ismag) &&
+        float32_is_zero_or_normal(a) && float32_is_zero_or_normal(b)) {
+        if (isless(ua.h, ub.h)) {
+            return flags & minmax_ismin ? a : b;
+        }
+        if (isgreater(ua.h, ub.h)) {
+            return flags & minmax_ismin ? b : a;
+        }
+        if (float32_val(a) == float32_val(b)) {
+            return a;
+        }
+    }
 
     float32_unpack_canonical(&pa, a, s);
     float32_unpack_canonical(&pb, b, s);
@@ -4293,6 +4435,28 @@ static float32 float32_minmax(float32 a, float32 b, float_status *s, int flags)
 static float64 float64_minmax(float64 a, float64 b, float_status *s, int flags)
 {
     FloatParts64 pa, pb, *pr;
+    union_float64 ua, ub;
+
+    ua.s = a;
+    ub.s = b;
+
+    /*
+     * Between zeros and normals no flag can be raised and the result is
+     * one of the inputs, unchanged.  Only the magnitude variants and
+     * comparing zeros of opposite sign need the soft path.
+     */
+    if (!QEMU_NO_HARDFLOAT && !(flags & minmax_ismag) &&
+        float64_is_zero_or_normal(a) && float64_is_zero_or_normal(b)) {
+        if (isless(ua.h, ub.h)) {
+            return flags & minmax_ismin ? a : b;
+        }
+        if (isgreater(ua.h, ub.h)) {
+            return flags & minmax_ismin ? b : a;
+        }
+        if (float64_val(a) == float64_val(b)) {
+            return a;
+        }
+    }
 
     float64_unpack_canonical(&pa, a, s);
     float64_unpack_canonical(&pb, b, s);
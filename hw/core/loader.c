@@ -140,6 +140,114 @@ ssize_t load_image_targphys_as(const char *filename,
     return size;
 }
 
+typedef struct DirectImage {
+    char *name;
+    int fd;
+    hwaddr addr;
+    uint64_t size;
+    /* To detect that the file was rewritten after it was loaded */
+    time_t mtime;
+    time_t ctime;
+} DirectImage;
+
+static bool direct_image_changed(DirectImage *di)
+{
+    struct stat st;
+
+    if (fstat(di->fd, &st) < 0) {
+        return true;
+    }
+    return st.st_size != di->size || st.st_mtime != di->mtime ||
+           st.st_ctime != di->ctime;
+}
+
+static void direct_image_reset(void *opaque)
+{
+    DirectImage *di = opaque;
+    uint64_t done = 0;
+
+    /*
+     * As for ROMs, the incoming migration provides the contents, which the
+     * guest may have modified.
+     */
+    if (runstate_check(RUN_STATE_INMIGRATE)) {
+        return;
+    }
+
+    /*
+     * The image is not copied, so a file that was modified in place since
+     * it was loaded cannot be loaded consistently any more.  Check before
+     * touching guest memory, and again afterwards for changes during the
+     * read.
+     */
+    if (direct_image_changed(di)) {
+        goto changed;
+    }
+
+    trace_loader_direct_image_reset(di->name, di->addr, di->size);
+    while (done < di->size) {
+        hwaddr len = di->size - done;
+        ssize_t ret;
+        void *host;
+
+        host = address_space_map(&address_space_memory, di->addr + done, &len,
+                                 true, MEMTXATTRS_UNSPECIFIED);
+        if (!host) {
+            error_report("could not map 0x%" HWADDR_PRIx " for image '%s'",
+                         di->addr + done, di->name);
+            exit(1);
+        }
+        ret = pread(di->fd, host, len, done);
+        address_space_unmap(&address_space_memory, host, len, true,
+                            MAX(ret, 0));
+        if (ret <= 0) {
+            if (direct_image_changed(di)) {
+                goto changed;
+            }
+            error_report("could not read image '%s': %s", di->name,
+                         ret ? strerror(errno) : "unexpected end of file");
+            exit(1);
+        }
+        done += ret;
+    }
+
+    if (direct_image_changed(di)) {
+        goto changed;
+    }
+    return;
+
+changed:
+    error_report("image '%s' was modified after it was loaded", di->name);
+    exit(1);
+}
+
+ssize_t load_image_targphys_direct(const char *filename,
+                                   hwaddr addr, uint64_t max_sz)
+{
+    DirectImage *di;
+    struct stat st;
+    int fd;
+
+    fd = qemu_open_old(filename, O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size > max_sz) {
+        close(fd);
+        return -1;
+    }
+
+    di = g_new0(DirectImage, 1);
+    di->name = g_strdup(filename);
+    di->fd = fd;
+    di->addr = addr;
+    di->size = st.st_size;
+    di->mtime = st.st_mtime;
+    di->ctime = st.st_ctime;
+    qemu_register_reset(direct_image_reset, di);
+    return st.st_size;
+}
+
 ssize_t load_image_mr(const char *filename, MemoryRegion *mr)
 {
     ssize_t size;
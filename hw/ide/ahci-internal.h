@@ -314,6 +314,8 @@ struct AHCIDevice {
     AHCIPortRegs port_regs;
     struct AHCIState *hba;
     QEMUBH *check_bh;
+    /* Reports the NCQ commands in @finished with a single SDB FIS */
+    QEMUBH *sdb_bh;
     uint8_t *lst;
     uint8_t *res_fis;
     bool done_first_drq;
@@ -672,6 +672,8 @@ static void ahci_reset_port(AHCIState *s, int port)
     pr->cmd_issue = 0;
     d->busy_slot = -1;
     d->init_d2h_sent = false;
+    d->finished = 0;
+    qemu_bh_cancel(d->sdb_bh);
 
     ide_state = &s->dev[port].port.ifs[0];
     if (!ide_state->blk) {
@@ -783,9 +785,8 @@ static void ahci_unmap_clb_address(AHCIDevice *ad)
     ad->lst = NULL;
 }
 
-static void ahci_write_fis_sdb(AHCIState *s, NCQTransferState *ncq_tfs)
+static void ahci_write_fis_sdb(AHCIState *s, AHCIDevice *ad)
 {
-    AHCIDevice *ad = ncq_tfs->drive;
     AHCIPortRegs *pr = &ad->port_regs;
     IDEState *ide_state;
     SDBFIS *sdb_fis;
@@ -825,6 +826,16 @@ static void ahci_write_fis_sdb(AHCIState *s, NCQTransferState *ncq_tfs)
     }
 }
 
+static void ahci_sdb_bh(void *opaque)
+{
+    AHCIDevice *ad = opaque;
+
+    if (ad->finished) {
+        trace_ahci_sdb_bh(ad->hba, ad->port_no, ad->finished);
+        ahci_write_fis_sdb(ad->hba, ad);
+    }
+}
+
 static void ahci_write_fis_pio(AHCIDevice *ad, uint16_t len, bool pio_fis_i)
 {
     AHCIPortRegs *pr = &ad->port_regs;
@@ -1024,14 +1035,26 @@ static void ncq_err(NCQTransferState *ncq_tfs)
 
 static void ncq_finish(NCQTransferState *ncq_tfs)
 {
+    AHCIDevice *ad = ncq_tfs->drive;
+
     /* If we didn't error out, set our finished bit. Errored commands
      * do not get a bit set for the SDB FIS ACT register, nor do they
      * clear the outstanding bit in scr_act (PxSACT). */
     if (ncq_tfs->used) {
-        ncq_tfs->drive->finished |= (1 << ncq_tfs->tag);
+        ad->finished |= (1 << ncq_tfs->tag);
     }
 
-    ahci_write_fis_sdb(ncq_tfs->drive->hba, ncq_tfs);
+    /*
+     * Errors are reported right away.  Successful commands that complete
+     * together are reported with a single SDB FIS and interrupt, the
+     * SActive field of the FIS can hold all of them.
+     */
+    if (ad->port.ifs[0].status & ERR_STAT) {
+        qemu_bh_cancel(ad->sdb_bh);
+        ahci_write_fis_sdb(ad->hba, ad);
+    } else {
+        qemu_bh_schedule(ad->sdb_bh);
+    }
 
     trace_ncq_finish(ncq_tfs->drive->hba, ncq_tfs->drive->port_no,
                      ncq_tfs->tag);
@@ -1635,6 +1658,8 @@ void ahci_realize(AHCIState *s, DeviceState *qdev, AddressSpace *as)
         ad->port_no = i;
         ad->port.dma = &ad->dma;
         ad->port.dma->ops = &ahci_dma_ops;
+        ad->sdb_bh = qemu_bh_new_guarded(ahci_sdb_bh, ad,
+                                         &ad->mem_reentrancy_guard);
         ide_bus_register_restart_cb(&ad->port);
     }
     g_free(irqs);
@@ -1650,6 +1675,7 @@ void ahci_uninit(AHCIState *s)
         for (j = 0; j < 2; j++) {
             ide_exit(&ad->port.ifs[j]);
         }
+        qemu_bh_delete(ad->sdb_bh);
         object_unparent(OBJECT(&ad->port));
     }
 
@@ -1760,6 +1786,11 @@ static int ahci_state_post_load(void *opaque, int version_id)
             return -1;
         }
 
+        /* Report the commands that completed before the migration */
+        if (ad->finished) {
+            qemu_bh_schedule(ad->sdb_bh);
+        }
+
         for (j = 0; j < AHCI_MAX_CMDS; j++) {
             ncq_tfs = &ad->ncq_tfs[j];
             ncq_tfs->drive = ad;
@@ -200,8 +200,9 @@ static int64_t load_kernel_info(struct loongarch_boot_info *info)
                 exit(1);
             }
 
-            initrd_size = load_image_targphys(info->initrd_filename, initrd_offset,
-                                              info->ram_size - initrd_offset);
+            initrd_size = load_image_targphys_direct(info->initrd_filename,
+                                                     initrd_offset,
+                                                     info->ram_size - initrd_offset);
         }
 
         if (initrd_size == (target_ulong)-1) {
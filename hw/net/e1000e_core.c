@@ -56,6 +56,9 @@
 
 #define E1000E_MAX_TX_FRAGS (64)
 
+/* Maximum number of TX descriptors fetched with a single DMA read */
+#define E1000E_TX_DESC_BATCH (32)
+
 union e1000_rx_desc_union {
     struct e1000_rx_desc legacy;
     union e1000_rx_desc_extended extended;
@@ -763,9 +766,14 @@ e1000e_rx_wb_interrupt_cause(E1000ECore *core, int queue_idx,
     return (queue_idx == 0) ? E1000_ICR_RXQ0 : E1000_ICR_RXQ1;
 }
 
+/*
+ * Mark a processed descriptor as done if needed.  Only the copy in @dp is
+ * updated, the caller writes it back to the guest.  Returns the interrupt
+ * cause to raise, or 0 if the descriptor does not need to be written back.
+ */
 static uint32_t
-e1000e_txdesc_writeback(E1000ECore *core, dma_addr_t base,
-                        struct e1000_tx_desc *dp, bool *ide, int queue_idx)
+e1000e_txdesc_writeback(E1000ECore *core, struct e1000_tx_desc *dp,
+                        bool *ide, int queue_idx)
 {
     uint32_t txd_upper, txd_lower = le32_to_cpu(dp->lower.data);
 
@@ -779,8 +787,6 @@ e1000e_txdesc_writeback(E1000ECore *core, dma_addr_t base,
     txd_upper = le32_to_cpu(dp->upper.data) | E1000_TXD_STAT_DD;
 
     dp->upper.data = cpu_to_le32(txd_upper);
-    pci_dma_write(core->owner, base + ((char *)&dp->upper - (char *)dp),
-                  &dp->upper, sizeof(dp->upper));
     return e1000e_tx_wb_interrupt_cause(core, queue_idx);
 }
 
@@ -825,6 +831,21 @@ e1000e_ring_advance(E1000ECore *core, const E1000ERingInfo *r, uint32_t count)
     }
 }
 
+/* Number of descriptors available before the tail or the end of the ring */
+static inline uint32_t
+e1000e_ring_contig_descr_num(E1000ECore *core, const E1000ERingInfo *r)
+{
+    uint32_t ring_size = core->mac[r->dlen] / E1000_RING_DESC_LEN;
+
+    if (core->mac[r->dh] < core->mac[r->dt]) {
+        return core->mac[r->dt] - core->mac[r->dh];
+    }
+    if (core->mac[r->dh] >= ring_size) {
+        return 1;
+    }
+    return ring_size - core->mac[r->dh];
+}
+
 static inline uint32_t
 e1000e_ring_free_descr_num(E1000ECore *core, const E1000ERingInfo *r)
 {
@@ -902,7 +923,7 @@ static void
 e1000e_start_xmit(E1000ECore *core, const E1000E_TxRing *txr)
 {
     dma_addr_t base;
-    struct e1000_tx_desc desc;
+    struct e1000_tx_desc desc[E1000E_TX_DESC_BATCH];
     bool ide = false;
     const E1000ERingInfo *txi = txr->i;
     uint32_t cause = E1000_ICS_TXQE;
@@ -913,17 +934,41 @@ e1000e_start_xmit(E1000ECore *core, const E1000E_TxRing *txr)
     }
 
     while (!e1000e_ring_empty(core, txi)) {
+        uint32_t n = MIN(e1000e_ring_contig_descr_num(core, txi),
+                         E1000E_TX_DESC_BATCH);
+        uint32_t wb_first = n, wb_last = 0;
+        uint32_t i;
+
+        /*
+         * Fetch all the descriptors up to the tail (or the end of the ring)
+         * at once, and write back those that need it with a single DMA.
+         */
         base = e1000e_ring_head_descr(core, txi);
+        pci_dma_read(core->owner, base, desc, n * sizeof(desc[0]));
 
-        pci_dma_read(core->owner, base, &desc, sizeof(desc));
+        for (i = 0; i < n; i++) {
+            uint32_t wb_cause;
 
-        trace_e1000e_tx_descr((void *)(intptr_t)desc.buffer_addr,
-                              desc.lower.data, desc.upper.data);
+            trace_e1000e_tx_descr((void *)(intptr_t)desc[i].buffer_addr,
+                                  desc[i].lower.data, desc[i].upper.data);
 
-        e1000e_process_tx_desc(core, txr->tx, &desc, txi->idx);
-        cause |= e1000e_txdesc_writeback(core, base, &desc, &ide, txi->idx);
+            e1000e_process_tx_desc(core, txr->tx, &desc[i], txi->idx);
+            wb_cause = e1000e_txdesc_writeback(core, &desc[i], &ide, txi->idx);
+            if (wb_cause) {
+                cause |= wb_cause;
+                wb_first = MIN(wb_first, i);
+                wb_last = i;
+            }
+        }
+
+        if (wb_first < n) {
+            trace_e1000e_tx_descr_writeback(txi->idx, wb_first, wb_last);
+            pci_dma_write(core->owner, base + wb_first * sizeof(desc[0]),
+                          &desc[wb_first],
+                          (wb_last - wb_first + 1) * sizeof(desc[0]));
+        }
 
-        e1000e_ring_advance(core, txi, 1);
+        e1000e_ring_advance(core, txi, n);
     }
 
     if (!ide || !e1000e_intrmgr_delay_tx_causes(core, &cause)) {
@@ -57,6 +57,9 @@
 
 #define E1000E_MAX_TX_FRAGS (64)
 
+/* Maximum number of TX descriptors fetched with a single DMA read */
+#define IGB_TX_DESC_BATCH (32)
+
 union e1000_rx_desc_union {
     struct e1000_rx_desc legacy;
     union e1000_adv_rx_desc adv;
@@ -731,6 +734,21 @@ igb_ring_advance(IGBCore *core, const E1000ERingInfo *r, uint32_t count)
     }
 }
 
+/* Number of descriptors available before the tail or the end of the ring */
+static inline uint32_t
+igb_ring_contig_descr_num(IGBCore *core, const E1000ERingInfo *r)
+{
+    uint32_t ring_size = core->mac[r->dlen] / E1000_RING_DESC_LEN;
+
+    if (core->mac[r->dh] < core->mac[r->dt]) {
+        return core->mac[r->dt] - core->mac[r->dh];
+    }
+    if (core->mac[r->dh] >= ring_size) {
+        return 1;
+    }
+    return ring_size - core->mac[r->dh];
+}
+
 static inline uint32_t
 igb_ring_free_descr_num(IGBCore *core, const E1000ERingInfo *r)
 {
@@ -826,39 +844,42 @@ igb_rx_ring_init(IGBCore *core, E1000E_RxRing *rxr, int idx)
     rxr->i      = &i[idx];
 }
 
-static uint32_t
-igb_txdesc_writeback(IGBCore *core, dma_addr_t base,
-                     union e1000_adv_tx_desc *tx_desc,
-                     const E1000ERingInfo *txi)
+/* Return the head write-back address of a queue, or 0 if it is disabled */
+static uint64_t
+igb_tx_head_wb_addr(IGBCore *core, const E1000ERingInfo *txi)
 {
-    PCIDevice *d;
-    uint32_t cmd_type_len = le32_to_cpu(tx_desc->read.cmd_type_len);
     uint64_t tdwba;
 
     tdwba = core->mac[E1000_TDWBAL(txi->idx) >> 2];
     tdwba |= (uint64_t)core->mac[E1000_TDWBAH(txi->idx) >> 2] << 32;
 
-    if (!(cmd_type_len & E1000_TXD_CMD_RS)) {
-        return 0;
-    }
+    return (tdwba & 1) ? tdwba & ~3 : 0;
+}
 
-    d = pcie_sriov_get_vf_at_index(core->owner, txi->idx % 8);
-    if (!d) {
-        d = core->owner;
+/*
+ * Mark a processed descriptor as done if needed.  Only the copy in @tx_desc
+ * is updated, the caller writes it (or the head) back to the guest.
+ * Returns true if the descriptor needs to be written back, in which case
+ * the interrupt causes to raise are added to @eic.
+ */
+static bool
+igb_txdesc_writeback(IGBCore *core, union e1000_adv_tx_desc *tx_desc,
+                     const E1000ERingInfo *txi, bool head_wb, uint32_t *eic)
+{
+    uint32_t cmd_type_len = le32_to_cpu(tx_desc->read.cmd_type_len);
+
+    if (!(cmd_type_len & E1000_TXD_CMD_RS)) {
+        return false;
     }
 
-    if (tdwba & 1) {
-        uint32_t buffer = cpu_to_le32(core->mac[txi->dh]);
-        pci_dma_write(d, tdwba & ~3, &buffer, sizeof(buffer));
-    } else {
+    if (!head_wb) {
         uint32_t status = le32_to_cpu(tx_desc->wb.status) | E1000_TXD_STAT_DD;
 
         tx_desc->wb.status = cpu_to_le32(status);
-        pci_dma_write(d, base + offsetof(union e1000_adv_tx_desc, wb),
-            &tx_desc->wb, sizeof(tx_desc->wb));
     }
 
-    return igb_tx_wb_eic(core, txi->idx);
+    *eic |= igb_tx_wb_eic(core, txi->idx);
+    return true;
 }
 
 static inline bool
@@ -878,8 +899,9 @@ igb_start_xmit(IGBCore *core, const IGB_TxRing *txr)
 {
     PCIDevice *d;
     dma_addr_t base;
-    union e1000_adv_tx_desc desc;
+    union e1000_adv_tx_desc desc[IGB_TX_DESC_BATCH];
     const E1000ERingInfo *txi = txr->i;
+    uint64_t head_wb;
     uint32_t eic = 0;
 
     if (!igb_tx_enabled(core, txi)) {
@@ -892,17 +914,50 @@ igb_start_xmit(IGBCore *core, const IGB_TxRing *txr)
         d = core->owner;
     }
 
+    head_wb = igb_tx_head_wb_addr(core, txi);
+
     while (!igb_ring_empty(core, txi)) {
+        uint32_t n = MIN(igb_ring_contig_descr_num(core, txi),
+                         IGB_TX_DESC_BATCH);
+        uint32_t wb_first = n, wb_last = 0;
+        uint32_t i;
+
+        /*
+         * Fetch all the descriptors up to the tail (or the end of the ring)
+         * at once, and write back those that need it (or the head) with a
+         * single DMA.
+         */
         base = igb_ring_head_descr(core, txi);
+        pci_dma_read(d, base, desc, n * sizeof(desc[0]));
+
+        for (i = 0; i < n; i++) {
+            trace_e1000e_tx_descr((void *)(intptr_t)desc[i].read.buffer_addr,
+                                  desc[i].read.cmd_type_len,
+                                  desc[i].wb.status);
+
+            igb_process_tx_desc(core, d, txr->tx, &desc[i], txi->idx);
+            if (igb_txdesc_writeback(core, &desc[i], txi, head_wb != 0,
+                                     &eic)) {
+                wb_first = MIN(wb_first, i);
+                wb_last = i;
+            }
+        }
 
-        pci_dma_read(d, base, &desc, sizeof(desc));
+        igb_ring_advance(core, txi, n);
 
-        trace_e1000e_tx_descr((void *)(intptr_t)desc.read.buffer_addr,
-                              desc.read.cmd_type_len, desc.wb.status);
+        if (wb_first == n) {
+            continue;
+        }
 
-        igb_process_tx_desc(core, d, txr->tx, &desc, txi->idx);
-        igb_ring_advance(core, txi, 1);
-        eic |= igb_txdesc_writeback(core, base, &desc, txi);
+        trace_e1000e_tx_descr_writeback(txi->idx, wb_first, wb_last);
+        if (head_wb) {
+            uint32_t buffer = cpu_to_le32(core->mac[txi->dh]);
+            pci_dma_write(d, head_wb, &buffer, sizeof(buffer));
+        } else {
+            pci_dma_write(d, base + wb_first * sizeof(desc[0]),
+                          &desc[wb_first],
+                          (wb_last - wb_first + 1) * sizeof(desc[0]));
+        }
     }
 
     if (eic) {
@@ -48,6 +48,7 @@
 #endif
 
 #define SCSI_WRITE_SAME_MAX         (512 * KiB)
+#define SCSI_DISK_MAX_PARALLEL      16
 #define SCSI_DMA_BUF_SIZE           (128 * KiB)
 #define SCSI_MAX_INQUIRY_LEN        256
 #define SCSI_MAX_MODE_LEN           256
@@ -1711,70 +1712,186 @@ static inline bool check_lba_range(SCSIDiskState *s,
             sector_num + nb_sectors <= s->qdev.max_lba + 1);
 }
 
-typedef struct UnmapCBData {
+/*
+ * UNMAP and WRITE SAME are split into several independent block layer
+ * requests, which are kept in flight in parallel.
+ */
+typedef struct SCSIDiskParallelIO SCSIDiskParallelIO;
+
+typedef struct SCSIDiskIOSlot {
+    SCSIDiskParallelIO *pio;
+    BlockAIOCB *aiocb;
+    BlockAcctCookie acct;
+    QEMUIOVector qiov;
+} SCSIDiskIOSlot;
+
+/*
+ * Submit the next block layer request of the command using @slot.
+ * Returns false if there is nothing left to submit.
+ */
+typedef bool SCSIDiskSubmitFunc(SCSIDiskParallelIO *pio, SCSIDiskIOSlot *slot);
+
+struct SCSIDiskParallelIO {
     SCSIDiskReq *r;
-    uint8_t *inbuf;
-    int count;
-} UnmapCBData;
+    SCSIDiskSubmitFunc *submit;
+    SCSIDiskIOSlot slots[SCSI_DISK_MAX_PARALLEL];
+    int in_flight;
+    int ret;
+    bool canceling;
+    /* Freed with qemu_vfree() when the command completes */
+    void *buf;
+};
+
+/* Keep the SCSI request cancelable through one of the pending requests */
+static void scsi_disk_parallel_io_update_aiocb(SCSIDiskParallelIO *pio)
+{
+    int i;
 
-static void scsi_unmap_complete(void *opaque, int ret);
+    pio->r->req.aiocb = NULL;
+    for (i = 0; i < SCSI_DISK_MAX_PARALLEL; i++) {
+        if (pio->slots[i].aiocb) {
+            pio->r->req.aiocb = pio->slots[i].aiocb;
+            break;
+        }
+    }
+}
 
-static void scsi_unmap_complete_noio(UnmapCBData *data, int ret)
+static void scsi_disk_parallel_io_cb(void *opaque, int ret)
 {
-    SCSIDiskReq *r = data->r;
+    SCSIDiskIOSlot *slot = opaque;
+    SCSIDiskParallelIO *pio = slot->pio;
+    SCSIDiskReq *r = pio->r;
     SCSIDiskState *s = DO_UPCAST(SCSIDiskState, qdev, r->req.dev);
+    int i;
 
-    assert(r->req.aiocb == NULL);
+    /* The request must only run in the BlockBackend's AioContext */
+    assert(blk_get_aio_context(s->qdev.conf.blk) ==
+           qemu_get_current_aio_context());
 
-    if (data->count > 0) {
-        uint64_t sector_num = ldq_be_p(&data->inbuf[0]);
-        uint32_t nb_sectors = ldl_be_p(&data->inbuf[8]) & 0xffffffffULL;
-        r->sector = sector_num * (s->qdev.blocksize / BDRV_SECTOR_SIZE);
-        r->sector_count = nb_sectors * (s->qdev.blocksize / BDRV_SECTOR_SIZE);
+    assert(slot->aiocb != NULL);
+    slot->aiocb = NULL;
+    pio->in_flight--;
 
-        if (!check_lba_range(s, sector_num, nb_sectors)) {
-            block_acct_invalid(blk_get_stats(s->qdev.conf.blk),
-                               BLOCK_ACCT_UNMAP);
-            scsi_check_condition(r, SENSE_CODE(LBA_OUT_OF_RANGE));
-            goto done;
+    /*
+     * With rerror/werror=ignore the command goes on as if the request had
+     * succeeded, like for the other commands.  Only the first error that is
+     * not ignored ends the command.
+     */
+    if (ret < 0 && !pio->ret && !r->req.io_canceled) {
+        BlockErrorAction action = blk_get_error_action(s->qdev.conf.blk,
+                                                       false, -ret);
+
+        if (action == BLOCK_ERROR_ACTION_IGNORE) {
+            blk_error_action(s->qdev.conf.blk, action, false, -ret);
+            ret = 0;
         }
+    }
 
-        block_acct_start(blk_get_stats(s->qdev.conf.blk), &r->acct,
-                         r->sector_count * BDRV_SECTOR_SIZE,
-                         BLOCK_ACCT_UNMAP);
-
-        r->req.aiocb = blk_aio_pdiscard(s->qdev.conf.blk,
-                                        r->sector * BDRV_SECTOR_SIZE,
-                                        r->sector_count * BDRV_SECTOR_SIZE,
-                                        scsi_unmap_complete, data);
-        data->count--;
-        data->inbuf += 16;
+    if (ret < 0) {
+        if (!pio->ret) {
+            /* Accounted by scsi_handle_rw_error() depending on the action */
+            pio->ret = ret;
+            r->acct = slot->acct;
+        } else {
+            block_acct_failed(blk_get_stats(s->qdev.conf.blk), &slot->acct);
+        }
+    } else {
+        block_acct_done(blk_get_stats(s->qdev.conf.blk), &slot->acct);
+    }
+
+    if (r->req.io_canceled && !pio->canceling) {
+        pio->canceling = true;
+        for (i = 0; i < SCSI_DISK_MAX_PARALLEL; i++) {
+            if (pio->slots[i].aiocb) {
+                blk_aio_cancel_async(pio->slots[i].aiocb);
+            }
+        }
+    }
+
+    if (!r->req.io_canceled && !pio->ret && pio->submit(pio, slot)) {
+        pio->in_flight++;
+    }
+
+    scsi_disk_parallel_io_update_aiocb(pio);
+    if (pio->in_flight) {
         return;
     }
 
-    scsi_req_complete(&r->req, GOOD);
+    if (!scsi_disk_req_check_error(r, pio->ret, true)) {
+        if (pio->ret < 0) {
+            /* The action changed to ignore in the meantime */
+            block_acct_done(blk_get_stats(s->qdev.conf.blk), &r->acct);
+        }
+        scsi_req_complete(&r->req, GOOD);
+    }
 
-done:
     scsi_req_unref(&r->req);
-    g_free(data);
+    qemu_vfree(pio->buf);
+    g_free(pio);
 }
 
-static void scsi_unmap_complete(void *opaque, int ret)
+/*
+ * Start the command described by @pio, which must be at the beginning of a
+ * g_malloc()ed structure.  It is freed when the command completes.
+ */
+static void scsi_disk_parallel_io_start(SCSIDiskParallelIO *pio)
 {
-    UnmapCBData *data = opaque;
-    SCSIDiskReq *r = data->r;
-    SCSIDiskState *s = DO_UPCAST(SCSIDiskState, qdev, r->req.dev);
+    SCSIDiskReq *r = pio->r;
+    int i;
 
-    assert(r->req.aiocb != NULL);
-    r->req.aiocb = NULL;
+    /* The matching unref is in scsi_disk_parallel_io_cb */
+    scsi_req_ref(&r->req);
 
-    if (scsi_disk_req_check_error(r, ret, true)) {
+    for (i = 0; i < SCSI_DISK_MAX_PARALLEL; i++) {
+        pio->slots[i].pio = pio;
+        if (!pio->submit(pio, &pio->slots[i])) {
+            break;
+        }
+        pio->in_flight++;
+    }
+
+    if (!pio->in_flight) {
+        scsi_req_complete(&r->req, GOOD);
         scsi_req_unref(&r->req);
-        g_free(data);
-    } else {
-        block_acct_done(blk_get_stats(s->qdev.conf.blk), &r->acct);
-        scsi_unmap_complete_noio(data, ret);
+        qemu_vfree(pio->buf);
+        g_free(pio);
+        return;
+    }
+
+    trace_scsi_disk_parallel_io_start(r->req.tag, pio->in_flight);
+    scsi_disk_parallel_io_update_aiocb(pio);
+}
+
+typedef struct UnmapCBData {
+    SCSIDiskParallelIO pio; /* must be first */
+    uint8_t *inbuf;
+    int count;
+} UnmapCBData;
+
+static bool scsi_unmap_submit(SCSIDiskParallelIO *pio, SCSIDiskIOSlot *slot)
+{
+    UnmapCBData *data = container_of(pio, UnmapCBData, pio);
+    SCSIDiskState *s = DO_UPCAST(SCSIDiskState, qdev, pio->r->req.dev);
+    uint64_t sector_num;
+    uint32_t nb_sectors;
+
+    if (data->count == 0) {
+        return false;
     }
+
+    sector_num = ldq_be_p(&data->inbuf[0]);
+    nb_sectors = ldl_be_p(&data->inbuf[8]) & 0xffffffffULL;
+    data->count--;
+    data->inbuf += 16;
+
+    block_acct_start(blk_get_stats(s->qdev.conf.blk), &slot->acct,
+                     (uint64_t)nb_sectors * s->qdev.blocksize,
+                     BLOCK_ACCT_UNMAP);
+    slot->aiocb = blk_aio_pdiscard(s->qdev.conf.blk,
+                                   sector_num * s->qdev.blocksize,
+                                   (int64_t)nb_sectors * s->qdev.blocksize,
+                                   scsi_disk_parallel_io_cb, slot);
+    return true;
 }
 
 static void scsi_disk_emulate_unmap(SCSIDiskReq *r, uint8_t *inbuf)
@@ -1783,6 +1900,7 @@ static void scsi_disk_emulate_unmap(SCSIDiskReq *r, uint8_t *inbuf)
     uint8_t *p = inbuf;
     int len = r->req.cmd.xfer;
     UnmapCBData *data;
+    int i, count;
 
     /* Reject ANCHOR=1.  */
     if (r->req.cmd.buf[1] & 0x1) {
@@ -1808,14 +1926,30 @@ static void scsi_disk_emulate_unmap(SCSIDiskReq *r, uint8_t *inbuf)
         return;
     }
 
+    /*
+     * The descriptors are unmapped in parallel, so check them all before
+     * submitting any of them.
+     */
+    count = lduw_be_p(&p[2]) >> 4;
+    for (i = 0; i < count; i++) {
+        uint64_t sector_num = ldq_be_p(&p[8 + i * 16]);
+        uint32_t nb_sectors = ldl_be_p(&p[8 + i * 16 + 8]) & 0xffffffffULL;
+
+        if (!check_lba_range(s, sector_num, nb_sectors)) {
+            block_acct_invalid(blk_get_stats(s->qdev.conf.blk),
+                               BLOCK_ACCT_UNMAP);
+            scsi_check_condition(r, SENSE_CODE(LBA_OUT_OF_RANGE));
+            return;
+        }
+    }
+
     data = g_new0(UnmapCBData, 1);
-    data->r = r;
+    data->pio.r = r;
+    data->pio.submit = scsi_unmap_submit;
     data->inbuf = &p[8];
-    data->count = lduw_be_p(&p[2]) >> 4;
+    data->count = count;
 
-    /* The matching unref is in scsi_unmap_complete, before data is freed.  */
-    scsi_req_ref(&r->req);
-    scsi_unmap_complete_noio(data, 0);
+    scsi_disk_parallel_io_start(&data->pio);
     return;
 
 invalid_param_len:
@@ -1829,51 +1963,33 @@ invalid_field:
 }
 
 typedef struct WriteSameCBData {
-    SCSIDiskReq *r;
-    int64_t sector;
-    int nb_sectors;
-    QEMUIOVector qiov;
-    struct iovec iov;
+    SCSIDiskParallelIO pio; /* must be first */
+    int64_t offset;
+    int64_t bytes;
+    size_t buf_len;
 } WriteSameCBData;
 
-static void scsi_write_same_complete(void *opaque, int ret)
+static bool scsi_write_same_submit(SCSIDiskParallelIO *pio,
+                                   SCSIDiskIOSlot *slot)
 {
-    WriteSameCBData *data = opaque;
-    SCSIDiskReq *r = data->r;
-    SCSIDiskState *s = DO_UPCAST(SCSIDiskState, qdev, r->req.dev);
-
-    assert(r->req.aiocb != NULL);
-    r->req.aiocb = NULL;
+    WriteSameCBData *data = container_of(pio, WriteSameCBData, pio);
+    SCSIDiskState *s = DO_UPCAST(SCSIDiskState, qdev, pio->r->req.dev);
+    size_t len = MIN(data->bytes, data->buf_len);
 
-    if (scsi_disk_req_check_error(r, ret, true)) {
-        goto done;
-    }
-
-    block_acct_done(blk_get_stats(s->qdev.conf.blk), &r->acct);
-
-    data->nb_sectors -= data->iov.iov_len / BDRV_SECTOR_SIZE;
-    data->sector += data->iov.iov_len / BDRV_SECTOR_SIZE;
-    data->iov.iov_len = MIN(data->nb_sectors * BDRV_SECTOR_SIZE,
-                            data->iov.iov_len);
-    if (data->iov.iov_len) {
-        block_acct_start(blk_get_stats(s->qdev.conf.blk), &r->acct,
-                         data->iov.iov_len, BLOCK_ACCT_WRITE);
-        /* Reinitialize qiov, to handle unaligned WRITE SAME request
-         * where final qiov may need smaller size */
-        qemu_iovec_init_external(&data->qiov, &data->iov, 1);
-        r->req.aiocb = blk_aio_pwritev(s->qdev.conf.blk,
-                                       data->sector << BDRV_SECTOR_BITS,
-                                       &data->qiov, 0,
-                                       scsi_write_same_complete, data);
-        return;
+    if (len == 0) {
+        return false;
     }
 
-    scsi_req_complete(&r->req, GOOD);
-
-done:
-    scsi_req_unref(&r->req);
-    qemu_vfree(data->iov.iov_base);
-    g_free(data);
+    /* All the requests write the same pattern buffer */
+    qemu_iovec_init_buf(&slot->qiov, pio->buf, len);
+    block_acct_start(blk_get_stats(s->qdev.conf.blk), &slot->acct,
+                     len, BLOCK_ACCT_WRITE);
+    slot->aiocb = blk_aio_pwritev(s->qdev.conf.blk, data->offset,
+                                  &slot->qiov, 0,
+                                  scsi_disk_parallel_io_cb, slot);
+    data->offset += len;
+    data->bytes -= len;
+    return true;
 }
 
 static void scsi_disk_emulate_write_same(SCSIDiskReq *r, uint8_t *inbuf)
@@ -1915,28 +2031,24 @@ static void scsi_disk_emulate_write_same(SCSIDiskReq *r, uint8_t *inbuf)
         return;
     }
 
+    /*
+     * Other patterns are written from a buffer that repeats the block,
+     * with several writes of up to SCSI_WRITE_SAME_MAX bytes in flight.
+     */
     data = g_new0(WriteSameCBData, 1);
-    data->r = r;
-    data->sector = r->req.cmd.lba * (s->qdev.blocksize / BDRV_SECTOR_SIZE);
-    data->nb_sectors = nb_sectors * (s->qdev.blocksize / BDRV_SECTOR_SIZE);
-    data->iov.iov_len = MIN(data->nb_sectors * BDRV_SECTOR_SIZE,
-                            SCSI_WRITE_SAME_MAX);
-    data->iov.iov_base = buf = blk_blockalign(s->qdev.conf.blk,
-                                              data->iov.iov_len);
-    qemu_iovec_init_external(&data->qiov, &data->iov, 1);
-
-    for (i = 0; i < data->iov.iov_len; i += l) {
-        l = MIN(s->qdev.blocksize, data->iov.iov_len - i);
+    data->pio.r = r;
+    data->pio.submit = scsi_write_same_submit;
+    data->offset = r->req.cmd.lba * s->qdev.blocksize;
+    data->bytes = (int64_t)nb_sectors * s->qdev.blocksize;
+    data->buf_len = MIN(data->bytes, SCSI_WRITE_SAME_MAX);
+    data->pio.buf = buf = blk_blockalign(s->qdev.conf.blk, data->buf_len);
+
+    for (i = 0; i < data->buf_len; i += l) {
+        l = MIN(s->qdev.blocksize, data->buf_len - i);
         memcpy(&buf[i], inbuf, l);
     }
 
-    scsi_req_ref(&r->req);
-    block_acct_start(blk_get_stats(s->qdev.conf.blk), &r->acct,
-                     data->iov.iov_len, BLOCK_ACCT_WRITE);
-    r->req.aiocb = blk_aio_pwritev(s->qdev.conf.blk,
-                                   data->sector << BDRV_SECTOR_BITS,
-                                   &data->qiov, 0,
-                                   scsi_write_same_complete, data);
+    scsi_disk_parallel_io_start(&data->pio);
 }
 
 static void scsi_disk_emulate_write_data(SCSIRequest *req)
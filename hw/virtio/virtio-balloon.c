@@ -374,7 +374,10 @@ static void virtio_balloon_handle_report(VirtIODevice *vdev, VirtQueue *vq)
                 continue;
             }
 
-            ram_block_discard_range(rb, ram_offset, size);
+            if (!ram_block_discard_range(rb, ram_offset, size)) {
+                /* Let migration skip the range until the guest reuses it */
+                qemu_guest_free_page_report(addr, size);
+            }
         }
 
 skip_element:
@@ -600,45 +600,24 @@ static int virtio_mem_set_block_state(VirtIOMEM *vmem, uint64_t start_gpa,
         return 0;
     }
 
-    if (vmem->prealloc) {
-        void *area = memory_region_get_ram_ptr(&vmem->memdev->mr) + offset;
-        int fd = memory_region_get_fd(&vmem->memdev->mr);
-        Error *local_err = NULL;
-
-        if (!qemu_prealloc_mem(fd, area, size, 1, NULL, false, &local_err)) {
-            static bool warned;
-
-            /*
-             * Warn only once, we don't want to fill the log with these
-             * warnings.
-             */
-            if (!warned) {
-                warn_report_err(local_err);
-                warned = true;
-            } else {
-                error_free(local_err);
-            }
-            ret = -EBUSY;
-        }
+    /*
+     * With "prealloc=on", the blocks were already preallocated by
+     * virtio_mem_prealloc_thread().
+     *
+     * Activate before notifying and rollback in case of any errors.
+     *
+     * When activating a yet inactive memslot, memory notifiers will get
+     * notified about the added memory region and can register with the
+     * RamDiscardManager; this will traverse all plugged blocks and skip the
+     * blocks we are plugging here. The following notification will inform
+     * registered listeners about the blocks we're plugging.
+     */
+    if (vmem->dynamic_memslots) {
+        virtio_mem_activate_memslots_to_plug(vmem, offset, size);
     }
-
-    if (!ret) {
-        /*
-         * Activate before notifying and rollback in case of any errors.
-         *
-         * When activating a yet inactive memslot, memory notifiers will get
-         * notified about the added memory region and can register with the
-         * RamDiscardManager; this will traverse all plugged blocks and skip the
-         * blocks we are plugging here. The following notification will inform
-         * registered listeners about the blocks we're plugging.
-         */
-        if (vmem->dynamic_memslots) {
-            virtio_mem_activate_memslots_to_plug(vmem, offset, size);
-        }
-        ret = virtio_mem_notify_plug(vmem, offset, size);
-        if (ret && vmem->dynamic_memslots) {
-            virtio_mem_deactivate_unplugged_memslots(vmem, offset, size);
-        }
+    ret = virtio_mem_notify_plug(vmem, offset, size);
+    if (ret && vmem->dynamic_memslots) {
+        virtio_mem_deactivate_unplugged_memslots(vmem, offset, size);
     }
     if (ret) {
         /* Could be preallocation or a notifier populated memory. */
@@ -683,6 +662,157 @@ static int virtio_mem_state_change_request(VirtIOMEM *vmem, uint64_t gpa,
     return VIRTIO_MEM_RESP_ACK;
 }
 
+static void virtio_mem_handle_request(VirtIODevice *vdev, VirtQueue *vq);
+
+static void *virtio_mem_prealloc_thread(void *opaque)
+{
+    VirtIOMEM *vmem = opaque;
+    HostMemoryBackend *backend = vmem->memdev;
+    const uint64_t offset = vmem->plug_gpa - vmem->addr;
+    const uint64_t size = vmem->plug_nb_blocks * vmem->block_size;
+    void *area = memory_region_get_ram_ptr(&backend->mr) + offset;
+    int fd = memory_region_get_fd(&backend->mr);
+
+    /*
+     * Use the threads and thread context configured for the memory backend,
+     * so preallocation runs in parallel on the backend's host NUMA nodes.
+     */
+    qemu_prealloc_mem(fd, area, size, backend->prealloc_threads,
+                      backend->prealloc_context, false, &vmem->plug_err);
+    qemu_bh_schedule(vmem->plug_bh);
+    return NULL;
+}
+
+/*
+ * Complete a plug request that was waiting for preallocation, waiting for
+ * the preallocation to finish first if necessary.
+ */
+static void virtio_mem_plug_finish(VirtIOMEM *vmem)
+{
+    VirtQueueElement *elem = vmem->plug_elem;
+    const uint64_t gpa = vmem->plug_gpa;
+    const uint16_t nb_blocks = vmem->plug_nb_blocks;
+    const uint64_t size = nb_blocks * vmem->block_size;
+    uint16_t type;
+
+    if (!elem) {
+        return;
+    }
+
+    qemu_thread_join(&vmem->plug_thread);
+    qemu_bh_cancel(vmem->plug_bh);
+    vmem->plug_elem = NULL;
+
+    if (vmem->plug_err) {
+        static bool warned;
+
+        /*
+         * Warn only once, we don't want to fill the log with these
+         * warnings.
+         */
+        if (!warned) {
+            warn_report_err(vmem->plug_err);
+            warned = true;
+        } else {
+            error_free(vmem->plug_err);
+        }
+        vmem->plug_err = NULL;
+        type = VIRTIO_MEM_RESP_BUSY;
+    } else {
+        type = virtio_mem_state_change_request(vmem, gpa, nb_blocks, true);
+    }
+
+    if (type != VIRTIO_MEM_RESP_ACK) {
+        /*
+         * No other request was processed in the meantime, so the range is
+         * still unplugged. Drop what preallocation populated.
+         */
+        ram_block_discard_range(vmem->memdev->mr.ram_block, gpa - vmem->addr,
+                                size);
+    }
+    trace_virtio_mem_plug_finish(gpa, nb_blocks);
+    virtio_mem_send_response_simple(vmem, elem, type);
+    g_free(elem);
+}
+
+/*
+ * Drop a plug request that was waiting for preallocation without
+ * responding, because the queue is being reset.
+ */
+static void virtio_mem_plug_cancel(VirtIOMEM *vmem)
+{
+    const uint64_t size = vmem->plug_nb_blocks * vmem->block_size;
+
+    if (!vmem->plug_elem) {
+        return;
+    }
+
+    qemu_thread_join(&vmem->plug_thread);
+    qemu_bh_cancel(vmem->plug_bh);
+    error_free(vmem->plug_err);
+    vmem->plug_err = NULL;
+
+    trace_virtio_mem_plug_cancel(vmem->plug_gpa, vmem->plug_nb_blocks);
+    ram_block_discard_range(vmem->memdev->mr.ram_block,
+                            vmem->plug_gpa - vmem->addr, size);
+    g_free(vmem->plug_elem);
+    vmem->plug_elem = NULL;
+}
+
+static void virtio_mem_plug_bh(void *opaque)
+{
+    VirtIOMEM *vmem = VIRTIO_MEM(opaque);
+
+    virtio_mem_plug_finish(vmem);
+    /* Process the requests that were queued in the meantime. */
+    virtio_mem_handle_request(VIRTIO_DEVICE(vmem), vmem->vq);
+}
+
+static int virtio_mem_migration_state_notifier(NotifierWithReturn *notifier,
+                                               MigrationEvent *e,
+                                               Error **errp)
+{
+    VirtIOMEM *vmem = container_of(notifier, VirtIOMEM, migration_state);
+
+    /*
+     * Complete a pending plug request before any RAM is migrated, so the
+     * response written to the used ring reaches the destination. As
+     * migration is active, the request will be rejected.
+     */
+    if (e->type == MIG_EVENT_PRECOPY_SETUP && vmem->plug_elem) {
+        virtio_mem_plug_bh(vmem);
+    }
+    return 0;
+}
+
+/*
+ * Start preallocating the blocks of a valid plug request in the background,
+ * so large requests don't stall the main loop. The guest gets its response
+ * once preallocation is done. Returns false if the request has to be
+ * processed synchronously, typically to reject it.
+ */
+static bool virtio_mem_plug_start_prealloc(VirtIOMEM *vmem,
+                                           VirtQueueElement *elem,
+                                           uint64_t gpa, uint16_t nb_blocks)
+{
+    const uint64_t size = nb_blocks * vmem->block_size;
+
+    if (!virtio_mem_valid_range(vmem, gpa, size) ||
+        vmem->size + size > vmem->requested_size ||
+        !virtio_mem_is_range_unplugged(vmem, gpa, size) ||
+        virtio_mem_is_busy()) {
+        return false;
+    }
+
+    trace_virtio_mem_plug_start_prealloc(gpa, nb_blocks);
+    vmem->plug_elem = elem;
+    vmem->plug_gpa = gpa;
+    vmem->plug_nb_blocks = nb_blocks;
+    qemu_thread_create(&vmem->plug_thread, "virtio-mem-plug",
+                       virtio_mem_prealloc_thread, vmem, QEMU_THREAD_JOINABLE);
+    return true;
+}
+
 static void virtio_mem_plug_request(VirtIOMEM *vmem, VirtQueueElement *elem,
                                     struct virtio_mem_req *req)
 {
@@ -691,6 +821,10 @@ static void virtio_mem_plug_request(VirtIOMEM *vmem, VirtQueueElement *elem,
     uint16_t type;
 
     trace_virtio_mem_plug_request(gpa, nb_blocks);
+    if (vmem->prealloc &&
+        virtio_mem_plug_start_prealloc(vmem, elem, gpa, nb_blocks)) {
+        return;
+    }
     type = virtio_mem_state_change_request(vmem, gpa, nb_blocks, true);
     virtio_mem_send_response_simple(vmem, elem, type);
 }
@@ -805,6 +939,11 @@ static void virtio_mem_handle_request(VirtIODevice *vdev, VirtQueue *vq)
     uint16_t type;
 
     while (true) {
+        /* Requests are processed in order, wait for a pending plug. */
+        if (vmem->plug_elem) {
+            return;
+        }
+
         elem = virtqueue_pop(vq, sizeof(VirtQueueElement));
         if (!elem) {
             return;
@@ -850,7 +989,9 @@ static void virtio_mem_handle_request(VirtIODevice *vdev, VirtQueue *vq)
             return;
         }
 
-        g_free(elem);
+        if (elem != vmem->plug_elem) {
+            g_free(elem);
+        }
     }
 }
 
@@ -899,6 +1040,8 @@ static void virtio_mem_system_reset(void *opaque)
 {
     VirtIOMEM *vmem = VIRTIO_MEM(opaque);
 
+    virtio_mem_plug_cancel(vmem);
+
     /*
      * During usual resets, we will unplug all memory and shrink the usable
      * region size. This is, however, not possible in all scenarios. Then,
@@ -1124,6 +1267,9 @@ static void virtio_mem_device_realize(DeviceState *dev, Error **errp)
                              &vmstate_virtio_mem_device_early, vmem);
     }
     qemu_register_reset(virtio_mem_system_reset, vmem);
+    vmem->plug_bh = virtio_bh_new_guarded(dev, virtio_mem_plug_bh, vmem);
+    migration_add_notifier(&vmem->migration_state,
+                           virtio_mem_migration_state_notifier);
 
     /*
      * Set ourselves as RamDiscardManager before the plug handler maps the
@@ -1138,6 +1284,11 @@ static void virtio_mem_device_unrealize(DeviceState *dev)
     VirtIODevice *vdev = VIRTIO_DEVICE(dev);
     VirtIOMEM *vmem = VIRTIO_MEM(dev);
 
+    migration_remove_notifier(&vmem->migration_state);
+    /* The device is going away, there is nobody to respond to */
+    virtio_mem_plug_cancel(vmem);
+    qemu_bh_delete(vmem->plug_bh);
+
     /*
      * The unplug handler unmapped the memory region, it cannot be
      * found via an address space anymore. Unset ourselves.
@@ -1430,16 +1581,39 @@ static const VMStateDescription vmstate_virtio_mem_device_early = {
     },
 };
 
+static int virtio_mem_pre_save(void *opaque)
+{
+    VirtIOMEM *vmem = VIRTIO_MEM(opaque);
+
+    /*
+     * Migration completes pending plug requests during setup. Without that,
+     * e.g. when saving a snapshot, RAM was already saved and the response
+     * would be lost.
+     */
+    if (vmem->plug_elem) {
+        error_report("virtio-mem: cannot save state while a plug request is"
+                     " pending");
+        return -EBUSY;
+    }
+    return 0;
+}
+
 static const VMStateDescription vmstate_virtio_mem = {
     .name = "virtio-mem",
     .minimum_version_id = 1,
     .version_id = 1,
+    .pre_save = virtio_mem_pre_save,
     .fields = (const VMStateField[]) {
         VMSTATE_VIRTIO_DEVICE,
         VMSTATE_END_OF_LIST()
     },
 };
 
+static void virtio_mem_device_reset(VirtIODevice *vdev)
+{
+    virtio_mem_plug_cancel(VIRTIO_MEM(vdev));
+}
+
 static void virtio_mem_fill_device_info(const VirtIOMEM *vmem,
                                         VirtioMEMDeviceInfo *vi)
 {
@@ -1859,6 +2033,7 @@ static void virtio_mem_class_init(ObjectClass *klass, void *data)
     vdc->get_config = virtio_mem_get_config;
     vdc->get_features = virtio_mem_get_features;
     vdc->validate_features = virtio_mem_validate_features;
+    vdc->reset = virtio_mem_device_reset;
     vdc->vmsd = &vmstate_virtio_mem_device;
 
     vmc->fill_device_info = virtio_mem_fill_device_info;
@@ -28,6 +28,7 @@
 #include "block/block-common.h"
 #include "block/block-global-state.h"
 #include "block/snapshot.h"
+#include "qemu/interval-tree.h"
 #include "qemu/iov.h"
 #include "qemu/rcu.h"
 #include "qemu/stats64.h"
@@ -84,6 +85,7 @@ typedef struct BdrvTrackedRequest {
     int64_t overlap_bytes;
 
     QLIST_ENTRY(BdrvTrackedRequest) list;
+    IntervalTreeNode node; /* keyed by [overlap_offset, overlap_bytes) */
     Coroutine *co; /* owner, used for deadlock detection */
     CoQueue wait_queue; /* coroutines blocked on this request */
 
@@ -1238,6 +1240,13 @@ struct BlockDriverState {
     /* Protected by reqs_lock.  */
     QemuMutex reqs_lock;
     QLIST_HEAD(, BdrvTrackedRequest) tracked_requests;
+    /*
+     * The same requests indexed by overlap range.  Serialising requests
+     * are kept apart, so that a non-serialising request only needs to
+     * look for conflicts in serialising_requests.
+     */
+    IntervalTreeRoot plain_requests;
+    IntervalTreeRoot serialising_requests;
     CoQueue flush_queue;                  /* Serializing flush queue */
     bool active_flush_req;                /* Flush request in flight? */
 
@@ -152,6 +152,63 @@ void block_job_ratelimit_processed_bytes(BlockJob *job, uint64_t n);
  */
 void block_job_ratelimit_sleep(BlockJob *job);
 
+/**
+ * BlockJobChunkTuner:
+ *
+ * Adapts the size of the requests of a job that keeps several of them in
+ * flight to the throughput measured over windows of BLOCK_JOB_SLICE_TIME,
+ * see block_job_chunk_size().
+ */
+typedef struct BlockJobChunkTuner {
+    int64_t min_chunk;
+    int64_t max_chunk;
+    int64_t chunk;
+    int64_t start_ns;
+    int64_t bytes;
+    bool saturated;
+    bool grow;
+    bool changed;
+    unsigned hold;
+    uint64_t last_bw;
+    /* Throughput of the last saturated window in bytes/s, 0 until then */
+    uint64_t bw;
+} BlockJobChunkTuner;
+
+/**
+ * block_job_chunk_tuner_init:
+ *
+ * Start with requests of @chunk bytes, which is then moved between
+ * @min_chunk and @max_chunk by powers of two.
+ */
+void block_job_chunk_tuner_init(BlockJobChunkTuner *t, int64_t min_chunk,
+                                int64_t max_chunk, int64_t chunk);
+
+/**
+ * block_job_chunk_tuner_restart:
+ *
+ * Start a new measurement window, e.g. after the job was paused.
+ */
+void block_job_chunk_tuner_restart(BlockJobChunkTuner *t);
+
+/**
+ * block_job_chunk_done:
+ *
+ * To be called when a request of @bytes bytes completed successfully.
+ */
+void block_job_chunk_done(BlockJobChunkTuner *t, int64_t bytes);
+
+/**
+ * block_job_chunk_size:
+ * @saturated: Whether all request slots of the job are in use.
+ *
+ * Returns the maximum size of the next request of @job.  At the end of each
+ * window in which the job was saturated, the size is doubled or halved in
+ * the direction that improved the throughput.  With a rate limit, requests
+ * are kept small enough for the limit to be applied smoothly instead.
+ */
+int64_t block_job_chunk_size(BlockJob *job, BlockJobChunkTuner *t,
+                             bool saturated);
+
 /**
  * block_job_error_action:
  * @job: The job to signal an error for.
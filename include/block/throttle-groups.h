@@ -49,6 +49,12 @@ typedef struct ThrottleGroupMember {
      */
     unsigned int restart_pending;
 
+    /* Bytes and operations already accounted in the group that this
+     * member can use without taking the ThrottleGroup lock, packed as
+     * described in throttle-groups.c.  Accessed with atomic operations.
+     */
+    uint64_t credit[THROTTLE_MAX];
+
     /* The following fields are protected by the ThrottleGroup lock.
      * See the ThrottleGroup documentation for details.
      * throttle_state tells us if I/O limits are configured. */
@@ -332,4 +332,29 @@ int qcrypto_tls_session_get_key_size(QCryptoTLSSession *sess,
  */
 char *qcrypto_tls_session_get_peer_name(QCryptoTLSSession *sess);
 
+typedef enum {
+    QCRYPTO_TLS_KTLS_TX = (1 << 0),
+    QCRYPTO_TLS_KTLS_RX = (1 << 1),
+} QCryptoTLSSessionKTLS;
+
+/**
+ * qcrypto_tls_session_enable_ktls:
+ * @sess: the TLS session object
+ * @fd: the TCP socket that the session is running over
+ *
+ * If the credentials have the "ktls" property enabled, hand the
+ * record layer of a completed session over to the kernel TLS
+ * implementation of @fd. For every direction that is offloaded,
+ * payload data must from then on be sent or received with plain
+ * socket I/O on @fd, and no longer through this session object.
+ *
+ * Offloading is best effort and depends on the kernel, the protocol
+ * version and the cipher that were negotiated.
+ *
+ * Returns: a mask of QCryptoTLSSessionKTLS flags for the directions
+ * now handled by the kernel, 0 if TLS stays entirely in userspace
+ */
+int qcrypto_tls_session_enable_ktls(QCryptoTLSSession *sess,
+                                    int fd);
+
 #endif /* QCRYPTO_TLSSESSION_H */
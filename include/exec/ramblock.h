@@ -58,6 +58,13 @@ struct RAMBlock {
     off_t bitmap_offset;
     uint64_t pages_offset;
 
+    /*
+     * Bitmap of pages the guest reported as free and that were discarded,
+     * see qemu_guest_free_page_report().  Allocated on the first report,
+     * protected by the BQL.
+     */
+    unsigned long *freemap;
+
     /* Bitmap of already received pages.  Only used on destination side. */
     unsigned long *receivedmap;
 
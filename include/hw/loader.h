@@ -56,6 +56,25 @@ ssize_t load_image_targphys_as(const char *filename,
 ssize_t load_targphys_hex_as(const char *filename, hwaddr *entry,
                              AddressSpace *as);
 
+/**
+ * load_image_targphys_direct:
+ * @filename: Path to the image file
+ * @addr: Address to load the image to
+ * @max_sz: The maximum size of the image to load
+ *
+ * Load a fixed image into RAM without keeping a copy of it in a ROM blob.
+ * The file is kept open and read directly into guest memory on every
+ * system reset, so the memory footprint does not depend on its size.
+ * Unlike ROM blobs, the image does not show up in "info roms" and is not
+ * checked for overlaps.  The file must not be modified while QEMU runs; a
+ * reset after it was changed is refused with an error instead of loading
+ * inconsistent contents.
+ *
+ * Returns the size of the image on success, -1 otherwise.
+ */
+ssize_t load_image_targphys_direct(const char *filename,
+                                   hwaddr addr, uint64_t max_sz);
+
 /** load_image_targphys:
  * Same as load_image_targphys_as(), but doesn't allow the caller to specify
  * an AddressSpace.
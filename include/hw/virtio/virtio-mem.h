@@ -17,6 +17,8 @@
 #include "hw/virtio/virtio.h"
 #include "qapi/qapi-types-misc.h"
 #include "sysemu/hostmem.h"
+#include "qemu/notify.h"
+#include "qemu/thread.h"
 #include "qom/object.h"
 
 #define TYPE_VIRTIO_MEM "virtio-mem"
@@ -97,6 +99,18 @@ struct VirtIOMEM {
     /* whether to prealloc memory when plugging new blocks */
     bool prealloc;
 
+    /*
+     * Plug request waiting for preallocation, which runs in @plug_thread
+     * without the BQL; see virtio_mem_plug_finish().
+     */
+    VirtQueueElement *plug_elem;
+    uint64_t plug_gpa;
+    uint16_t plug_nb_blocks;
+    QemuThread plug_thread;
+    QEMUBH *plug_bh;
+    Error *plug_err;
+    NotifierWithReturn migration_state;
+
     /*
      * Whether we migrate properties that are immutable while migration is
      * active early, before state of other devices and especially, before
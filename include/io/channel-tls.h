@@ -49,6 +49,8 @@ struct QIOChannelTLS {
     QCryptoTLSSession *session;
     QIOChannelShutdown shutdown;
     guint hs_ioc_tag;
+    /* QCryptoTLSSessionKTLS directions handled by the kernel */
+    int ktls;
 };
 
 /**
@@ -21,10 +21,24 @@
 #include "qemu/osdep.h"
 #include "qapi/error.h"
 #include "qemu/module.h"
+#include "qemu/iov.h"
 #include "io/channel-tls.h"
+#include "io/channel-socket.h"
 #include "trace.h"
 #include "qemu/atomic.h"
 
+#ifdef CONFIG_KTLS
+#include <linux/tls.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+#define TLS_RECORD_TYPE_ALERT 21
+#define TLS_RECORD_TYPE_DATA 23
+#define TLS_ALERT_CLOSE_NOTIFY 0
+#endif
+
 
 static ssize_t qio_channel_tls_write_handler(const char *buf,
                                              size_t len,
@@ -159,6 +173,21 @@ static gboolean qio_channel_tls_handshake_io(QIOChannel *ioc,
                                              GIOCondition condition,
                                              gpointer user_data);
 
+static void qio_channel_tls_enable_ktls(QIOChannelTLS *ioc)
+{
+    QIOChannelSocket *sioc = (QIOChannelSocket *)object_dynamic_cast(
+        OBJECT(ioc->master), TYPE_QIO_CHANNEL_SOCKET);
+
+    if (!sioc) {
+        return;
+    }
+
+    ioc->ktls = qcrypto_tls_session_enable_ktls(ioc->session, sioc->fd);
+    if (ioc->ktls) {
+        trace_qio_channel_tls_ktls(ioc, ioc->ktls);
+    }
+}
+
 static void qio_channel_tls_handshake_task(QIOChannelTLS *ioc,
                                            QIOTask *task,
                                            GMainContext *context)
@@ -182,6 +211,7 @@ static void qio_channel_tls_handshake_task(QIOChannelTLS *ioc,
             qio_task_set_error(task, err);
         } else {
             trace_qio_channel_tls_credentials_allow(ioc);
+            qio_channel_tls_enable_ktls(ioc);
         }
         qio_task_complete(task);
     } else {
@@ -264,6 +294,66 @@ static void qio_channel_tls_finalize(Object *obj)
 }
 
 
+#ifdef CONFIG_KTLS
+/*
+ * Once the kernel decrypts incoming records, records other than
+ * application data are not processed but returned to the caller,
+ * tagged with a TLS_GET_RECORD_TYPE control message.  kTLS sessions do
+ * not exchange session tickets, so the only one expected is the alert
+ * closing the session.
+ */
+static ssize_t qio_channel_tls_ktls_readv(QIOChannelTLS *tioc,
+                                          const struct iovec *iov,
+                                          size_t niov,
+                                          Error **errp)
+{
+    QIOChannelSocket *sioc = QIO_CHANNEL_SOCKET(tioc->master);
+    char control[CMSG_SPACE(sizeof(unsigned char))];
+    struct msghdr msg = { 0 };
+    struct cmsghdr *cmsg;
+    unsigned char alert[2];
+    ssize_t ret;
+
+ retry:
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = niov;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ret = recvmsg(sioc->fd, &msg, 0);
+    if (ret < 0) {
+        if (errno == EAGAIN) {
+            return QIO_CHANNEL_ERR_BLOCK;
+        }
+        if (errno == EINTR) {
+            goto retry;
+        }
+
+        error_setg_errno(errp, errno,
+                         "Cannot read from TLS channel");
+        return -1;
+    }
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_TLS ||
+        cmsg->cmsg_type != TLS_GET_RECORD_TYPE ||
+        *CMSG_DATA(cmsg) == TLS_RECORD_TYPE_DATA) {
+        return ret;
+    }
+
+    /* Only the first ret bytes of iov were filled by recvmsg() */
+    if (*CMSG_DATA(cmsg) == TLS_RECORD_TYPE_ALERT && ret >= sizeof(alert) &&
+        iov_to_buf(iov, niov, 0, alert, sizeof(alert)) == sizeof(alert) &&
+        alert[1] == TLS_ALERT_CLOSE_NOTIFY) {
+        return 0;
+    }
+
+    error_setg(errp, "Unexpected TLS record of type %d",
+               *CMSG_DATA(cmsg));
+    return -1;
+}
+#endif
+
 static ssize_t qio_channel_tls_readv(QIOChannel *ioc,
                                      const struct iovec *iov,
                                      size_t niov,
@@ -276,6 +366,12 @@ static ssize_t qio_channel_tls_readv(QIOChannel *ioc,
     size_t i;
     ssize_t got = 0;
 
+#ifdef CONFIG_KTLS
+    if (tioc->ktls & QCRYPTO_TLS_KTLS_RX) {
+        return qio_channel_tls_ktls_readv(tioc, iov, niov, errp);
+    }
+#endif
+
     for (i = 0 ; i < niov ; i++) {
         ssize_t ret = qcrypto_tls_session_read(tioc->session,
                                                iov[i].iov_base,
@@ -318,6 +414,11 @@ static ssize_t qio_channel_tls_writev(QIOChannel *ioc,
     size_t i;
     ssize_t done = 0;
 
+    if (tioc->ktls & QCRYPTO_TLS_KTLS_TX) {
+        return qio_channel_writev_full(tioc->master, iov, niov,
+                                       NULL, 0, flags, errp);
+    }
+
     for (i = 0 ; i < niov ; i++) {
         ssize_t ret = qcrypto_tls_session_write(tioc->session,
                                                 iov[i].iov_base,
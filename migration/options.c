@@ -13,6 +13,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/error-report.h"
+#include "exec/memory.h"
 #include "exec/target_page.h"
 #include "qapi/clone-visitor.h"
 #include "qapi/error.h"
@@ -186,6 +187,7 @@ Property migration_properties[] = {
                         MIGRATION_CAPABILITY_SWITCHOVER_ACK),
     DEFINE_PROP_MIG_CAP("x-dirty-limit", MIGRATION_CAPABILITY_DIRTY_LIMIT),
     DEFINE_PROP_MIG_CAP("mapped-ram", MIGRATION_CAPABILITY_MAPPED_RAM),
+    DEFINE_PROP_MIG_CAP("x-lazy-restore", MIGRATION_CAPABILITY_X_LAZY_RESTORE),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -231,6 +233,13 @@ bool migrate_events(void)
     return s->capabilities[MIGRATION_CAPABILITY_EVENTS];
 }
 
+bool migrate_lazy_restore(void)
+{
+    MigrationState *s = migrate_get_current();
+
+    return s->capabilities[MIGRATION_CAPABILITY_X_LAZY_RESTORE];
+}
+
 bool migrate_mapped_ram(void)
 {
     MigrationState *s = migrate_get_current();
@@ -592,6 +601,30 @@ bool migrate_caps_check(bool *old_caps, bool *new_caps, Error **errp)
         }
     }
 
+    if (new_caps[MIGRATION_CAPABILITY_X_LAZY_RESTORE]) {
+        if (!new_caps[MIGRATION_CAPABILITY_MAPPED_RAM]) {
+            error_setg(errp, "Lazy restore requires mapped-ram");
+            return false;
+        }
+
+        if (new_caps[MIGRATION_CAPABILITY_MULTIFD]) {
+            error_setg(errp, "Lazy restore is incompatible with multifd");
+            return false;
+        }
+
+        if (!ram_lazy_load_available()) {
+            error_setg(errp, "Lazy restore is not supported by host kernel");
+            return false;
+        }
+
+        /* Loading lazily discards the RAM first to catch accesses */
+        if (ram_block_discard_is_disabled()) {
+            error_setg(errp, "Lazy restore is incompatible with devices that"
+                       " disable RAM discards");
+            return false;
+        }
+    }
+
     return true;
 }
 
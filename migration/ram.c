@@ -57,6 +57,7 @@
 #include "qemu/iov.h"
 #include "multifd.h"
 #include "sysemu/runstate.h"
+#include "migration/blocker.h"
 #include "rdma.h"
 #include "options.h"
 #include "sysemu/dirtylimit.h"
@@ -66,6 +67,9 @@
 
 #if defined(__linux__)
 #include "qemu/userfaultfd.h"
+#include "qemu/event_notifier.h"
+#include "io/channel-file.h"
+#include <poll.h>
 #endif /* defined(__linux__) */
 
 /***********************************************************/
@@ -2769,6 +2773,110 @@ static void migration_bitmap_clear_discarded_pages(RAMState *rs)
     }
 }
 
+#ifdef CONFIG_LINUX
+#define PAGEMAP_PRESENT     (1ULL << 63)
+#define PAGEMAP_SWAPPED     (1ULL << 62)
+#define PAGEMAP_BATCH       512
+
+/*
+ * Drop pages reported free by the guest from the initial dirty bitmap of
+ * @rb, unless they have been used since they were discarded.  Pages that
+ * are still neither mapped nor swapped out in the host page tables have
+ * not been accessed by the guest since the discard; any other page is
+ * forgotten from the free map and migrated normally.
+ *
+ * Returns the number of cleared bits in the RAMBlock dirty bitmap.
+ */
+static uint64_t ramblock_dirty_bitmap_clear_reported_pages(RAMBlock *rb,
+                                                           int pagemap_fd)
+{
+    const uintptr_t hps = qemu_real_host_page_size();
+    const unsigned long chunk =
+        MAX((PAGEMAP_BATCH - 1) * hps >> TARGET_PAGE_BITS, 1);
+    unsigned long pages = rb->used_length >> TARGET_PAGE_BITS;
+    uint64_t entries[PAGEMAP_BATCH];
+    uint64_t cleared_bits = 0;
+    unsigned long page, end, n, i;
+    uintptr_t first, last, h;
+
+    page = find_first_bit(rb->freemap, pages);
+    while (page < pages) {
+        end = find_next_zero_bit(rb->freemap, pages, page);
+        while (page < end) {
+            n = MIN(end - page, chunk);
+
+            /*
+             * Start dirty logging on the range before looking at the page
+             * tables, so that a page written after the check below is
+             * found dirty again by the next bitmap sync.
+             */
+            if (!migration_in_postcopy() && !migrate_background_snapshot()) {
+                migration_clear_memory_region_dirty_bitmap_range(rb, page, n);
+            }
+
+            first = (uintptr_t)ramblock_ptr(rb, page << TARGET_PAGE_BITS) / hps;
+            last = DIV_ROUND_UP((uintptr_t)ramblock_ptr(rb,
+                                    (page + n - 1) << TARGET_PAGE_BITS) +
+                                TARGET_PAGE_SIZE, hps);
+            if (pread(pagemap_fd, entries, (last - first) * sizeof(uint64_t),
+                      first * sizeof(uint64_t)) !=
+                (last - first) * sizeof(uint64_t)) {
+                return cleared_bits;
+            }
+
+            for (i = 0; i < n; i++, page++) {
+                uintptr_t host =
+                    (uintptr_t)ramblock_ptr(rb, page << TARGET_PAGE_BITS);
+                bool untouched = true;
+
+                for (h = host / hps; h * hps < host + TARGET_PAGE_SIZE; h++) {
+                    if (entries[h - first] &
+                        (PAGEMAP_PRESENT | PAGEMAP_SWAPPED)) {
+                        untouched = false;
+                        break;
+                    }
+                }
+                if (!untouched) {
+                    clear_bit(page, rb->freemap);
+                } else if (test_and_clear_bit(page, rb->bmap)) {
+                    cleared_bits++;
+                }
+            }
+        }
+        page = find_next_bit(rb->freemap, pages, end);
+    }
+    return cleared_bits;
+}
+
+static void migration_bitmap_clear_reported_pages(RAMState *rs)
+{
+    uint64_t pages;
+    RAMBlock *rb;
+    int fd;
+
+    fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        RAMBLOCK_FOREACH_NOT_IGNORED(rb) {
+            if (!rb->freemap || !rb->bmap) {
+                continue;
+            }
+            pages = ramblock_dirty_bitmap_clear_reported_pages(rb, fd);
+            rs->migration_dirty_pages -= pages;
+            trace_migration_bitmap_clear_reported_pages(rb->idstr, pages);
+        }
+    }
+    close(fd);
+}
+#else
+static void migration_bitmap_clear_reported_pages(RAMState *rs)
+{
+}
+#endif
+
 static bool ram_init_bitmaps(RAMState *rs, Error **errp)
 {
     bool ret = true;
@@ -2799,6 +2907,8 @@ out_unlock:
      * containing all 1s to exclude any discarded pages from migration.
      */
     migration_bitmap_clear_discarded_pages(rs);
+    /* Likewise for pages the guest reported free and has not reused. */
+    migration_bitmap_clear_reported_pages(rs);
     return true;
 }
 
@@ -2900,6 +3010,50 @@ void qemu_guest_free_page_hint(void *addr, size_t len)
     }
 }
 
+/*
+ * Record pages that the guest reported as free and that have been
+ * discarded on the host, e.g. by virtio-balloon free page reporting.  The
+ * record outlives the current migration: the next migration skips such
+ * pages in its first round as long as the guest has not touched them
+ * since, see migration_bitmap_clear_reported_pages().  While a migration
+ * is running, the pages are also dropped from the dirty bitmap right away,
+ * like hinted free pages.
+ *
+ * @addr is the host address of the start of the range and @len its length
+ * in bytes.
+ */
+void qemu_guest_free_page_report(void *addr, size_t len)
+{
+    RAMBlock *block;
+    ram_addr_t offset;
+    unsigned long start, end;
+
+    block = qemu_ram_block_from_host(addr, false, &offset);
+    if (!block || offset + len > block->used_length ||
+        qemu_ram_is_shared(block)) {
+        return;
+    }
+
+    /* Only record target pages that are entirely covered by the range */
+    start = DIV_ROUND_UP(offset, TARGET_PAGE_SIZE);
+    end = (offset + len) >> TARGET_PAGE_BITS;
+    if (start >= end) {
+        return;
+    }
+
+    if (!block->freemap) {
+        block->freemap = bitmap_new(block->max_length >> TARGET_PAGE_BITS);
+    }
+    bitmap_set(block->freemap, start, end - start);
+    trace_qemu_guest_free_page_report(block->idstr, start, end - start);
+
+    /* The dirty bitmap only exists once migration setup has created it */
+    if (block->bmap) {
+        qemu_guest_free_page_hint(block->host + (start << TARGET_PAGE_BITS),
+                                  (end - start) << TARGET_PAGE_BITS);
+    }
+}
+
 #define MAPPED_RAM_HDR_VERSION 1
 struct MappedRamHeader {
     uint32_t version;
@@ -3635,6 +3789,7 @@ static int ram_load_cleanup(void *opaque)
     }
 
     xbzrle_load_cleanup();
+    ram_lazy_load_finish();
 
     RAMBLOCK_FOREACH_NOT_IGNORED(rb) {
         g_free(rb->receivedmap);
@@ -3906,6 +4061,450 @@ static size_t ram_load_multifd_pages(void *host_addr, size_t size,
     return size;
 }
 
+#if defined(__linux__)
+/*
+ * Lazy loading of mapped-ram RAM blocks.
+ *
+ * Instead of reading all pages while loading the RAM section, the blocks are
+ * registered with userfaultfd in missing mode, much like postcopy does on
+ * the destination, with the migration file as the page source. The fault
+ * thread resolves guest accesses by reading the host page from the file;
+ * once the VM runs, the fill thread streams all remaining pages in the
+ * background and unregisters each block once it is completely populated.
+ *
+ * Until both threads are done, the RAM is incomplete and a migration blocker
+ * keeps it from being saved.
+ */
+typedef struct RAMLazyLoadBlock {
+    RAMBlock *rb;
+    /* Pages that still have to be read from the file */
+    unsigned long *bmap;
+} RAMLazyLoadBlock;
+
+typedef struct RAMLazyLoad {
+    int uffd;
+    /* Duplicate of the migration file descriptor */
+    int fd;
+    EventNotifier quit;
+    QemuThread fault_thread;
+    QemuThread fill_thread;
+    QemuMutex lock;
+    QemuCond cond;
+    /* RAMLazyLoadBlock of the registered blocks, protected by @lock */
+    GPtrArray *blocks;
+    /* No more blocks will be registered, protected by @lock */
+    bool load_done;
+    /* The VM was started, protected by @lock */
+    bool running;
+    /* A page could not be loaded */
+    bool failed;
+    VMChangeStateEntry *vmstate;
+    Error *blocker;
+} RAMLazyLoad;
+
+static RAMLazyLoad *ram_lazy_load;
+
+static RAMLazyLoadBlock *ram_lazy_load_find(RAMLazyLoad *ll, RAMBlock *rb)
+{
+    RAMLazyLoadBlock *lb = NULL;
+    unsigned int i;
+
+    qemu_mutex_lock(&ll->lock);
+    for (i = 0; i < ll->blocks->len; i++) {
+        RAMLazyLoadBlock *cur = g_ptr_array_index(ll->blocks, i);
+
+        if (cur->rb == rb) {
+            lb = cur;
+            break;
+        }
+    }
+    qemu_mutex_unlock(&ll->lock);
+    return lb;
+}
+
+/*
+ * Populate the host page at @offset of @lb, @buf is page_size bytes.
+ *
+ * The page is resolved even on failure, so that nothing stays blocked on it:
+ * data that cannot be read is replaced with zeroes, and a page that cannot
+ * be placed is unregistered. Returns a negative errno value in both cases.
+ */
+static int ram_lazy_load_page(RAMLazyLoad *ll, RAMLazyLoadBlock *lb,
+                              ram_addr_t offset, uint8_t *buf, bool fault)
+{
+    RAMBlock *block = lb->rb;
+    const size_t size = block->page_size;
+    const unsigned long first = offset >> TARGET_PAGE_BITS;
+    const unsigned long n = size >> TARGET_PAGE_BITS;
+    struct uffdio_copy copy;
+    unsigned long i;
+    ssize_t len;
+    int ret = 0;
+
+    len = pread(ll->fd, buf, size, block->pages_offset + offset);
+    if (len < 0) {
+        ret = -errno;
+        len = 0;
+    }
+    memset(buf + len, 0, size - len);
+    for (i = 0; i < n; i++) {
+        if (!test_bit(first + i, lb->bmap)) {
+            /* Pages not in the bitmap are zero, whatever the file contains */
+            memset(buf + (i << TARGET_PAGE_BITS), 0, TARGET_PAGE_SIZE);
+        } else if (((i + 1) << TARGET_PAGE_BITS) > len && !ret) {
+            /* The page was saved, so the file has been truncated */
+            ret = -EIO;
+        }
+    }
+
+    copy.dst = (uintptr_t)block->host + offset;
+    copy.src = (uintptr_t)buf;
+    copy.len = size;
+    copy.mode = 0;
+    if (ioctl(ll->uffd, UFFDIO_COPY, &copy)) {
+        if (errno == EEXIST) {
+            /* Populated by the other thread in the meantime */
+            if (fault) {
+                uffd_wakeup(ll->uffd, block->host + offset, size);
+            }
+        } else {
+            if (!ret) {
+                ret = -errno;
+            }
+            /* This also wakes up the faulting threads */
+            uffd_unregister_memory(ll->uffd, block->host + offset, size);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        clear_bit_atomic(first + i, lb->bmap);
+    }
+    trace_ram_lazy_load_page(block->idstr, offset, fault);
+    return ret;
+}
+
+/*
+ * A page of @block was resolved without its contents, so the guest memory is
+ * corrupted. Stop the VM in a state that can only be left with a reset.
+ */
+static void ram_lazy_load_error(RAMLazyLoad *ll, RAMBlock *block,
+                                ram_addr_t offset, int err)
+{
+    if (qatomic_xchg(&ll->failed, true)) {
+        return;
+    }
+    error_report("lazy restore: failed to load page of block %s at offset "
+                 RAM_ADDR_FMT ": %s, the guest needs a reset",
+                 block->idstr, offset, strerror(-err));
+    qemu_system_vmstop_request_prepare();
+    qemu_system_vmstop_request(RUN_STATE_INTERNAL_ERROR);
+}
+
+static void *ram_lazy_load_fault_thread(void *opaque)
+{
+    RAMLazyLoad *ll = opaque;
+    g_autofree uint8_t *buf = NULL;
+    size_t buf_size = 0;
+
+    rcu_register_thread();
+
+    while (true) {
+        struct pollfd pfd[2] = {
+            { .fd = ll->uffd, .events = POLLIN },
+            { .fd = event_notifier_get_fd(&ll->quit), .events = POLLIN },
+        };
+        struct uffd_msg msg;
+        RAMLazyLoadBlock *lb;
+        ram_addr_t offset = 0;
+        RAMBlock *block = NULL;
+        int ret = 0;
+
+        if (poll(pfd, ARRAY_SIZE(pfd), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error_report("%s: poll failed: %s", __func__, strerror(errno));
+            break;
+        }
+        if (pfd[1].revents) {
+            break;
+        }
+        if (uffd_read_events(ll->uffd, &msg, 1) <= 0 ||
+            msg.event != UFFD_EVENT_PAGEFAULT) {
+            continue;
+        }
+
+        WITH_RCU_READ_LOCK_GUARD() {
+            block = qemu_ram_block_from_host(
+                (void *)(uintptr_t)msg.arg.pagefault.address, false, &offset);
+            assert(block);
+            lb = ram_lazy_load_find(ll, block);
+            assert(lb);
+            if (buf_size < block->page_size) {
+                g_free(buf);
+                buf_size = block->page_size;
+                buf = g_malloc(buf_size);
+            }
+            offset = ROUND_DOWN(offset, block->page_size);
+            ret = ram_lazy_load_page(ll, lb, offset, buf, true);
+        }
+        if (ret) {
+            ram_lazy_load_error(ll, block, offset, ret);
+        }
+    }
+
+    rcu_unregister_thread();
+    return NULL;
+}
+
+/* Runs in the main loop once both threads are done. */
+static void ram_lazy_load_cleanup_bh(void *opaque)
+{
+    RAMLazyLoad *ll = opaque;
+    unsigned int i;
+
+    migrate_del_blocker(&ll->blocker);
+    qemu_del_vm_change_state_handler(ll->vmstate);
+
+    for (i = 0; i < ll->blocks->len; i++) {
+        RAMLazyLoadBlock *lb = g_ptr_array_index(ll->blocks, i);
+
+        g_free(lb->bmap);
+        g_free(lb);
+    }
+    g_ptr_array_free(ll->blocks, true);
+    event_notifier_cleanup(&ll->quit);
+    qemu_cond_destroy(&ll->cond);
+    qemu_mutex_destroy(&ll->lock);
+    uffd_close_fd(ll->uffd);
+    close(ll->fd);
+    g_free(ll);
+}
+
+static void *ram_lazy_load_fill_thread(void *opaque)
+{
+    RAMLazyLoad *ll = opaque;
+    unsigned int idx = 0;
+
+    rcu_register_thread();
+
+    /*
+     * Nothing touches the memory before the VM runs, except for faults that
+     * are handled anyway: leave the file to the rest of the incoming
+     * migration until then.
+     */
+    qemu_mutex_lock(&ll->lock);
+    while (!ll->running) {
+        qemu_cond_wait(&ll->cond, &ll->lock);
+    }
+    qemu_mutex_unlock(&ll->lock);
+
+    while (true) {
+        g_autofree uint8_t *buf = NULL;
+        unsigned long page, pages;
+        RAMLazyLoadBlock *lb;
+        RAMBlock *block;
+
+        qemu_mutex_lock(&ll->lock);
+        while (idx == ll->blocks->len && !ll->load_done) {
+            qemu_cond_wait(&ll->cond, &ll->lock);
+        }
+        lb = idx < ll->blocks->len ? g_ptr_array_index(ll->blocks, idx) :
+             NULL;
+        qemu_mutex_unlock(&ll->lock);
+        if (!lb) {
+            break;
+        }
+        idx++;
+
+        block = lb->rb;
+        buf = g_malloc(block->page_size);
+        pages = block->used_length >> TARGET_PAGE_BITS;
+        for (page = find_first_bit(lb->bmap, pages); page < pages;
+             page = find_next_bit(lb->bmap, pages, page)) {
+            ram_addr_t offset = ROUND_DOWN((ram_addr_t)page << TARGET_PAGE_BITS,
+                                           block->page_size);
+            int ret = ram_lazy_load_page(ll, lb, offset, buf, false);
+
+            if (ret) {
+                ram_lazy_load_error(ll, block, offset, ret);
+            }
+            page = (offset + block->page_size) >> TARGET_PAGE_BITS;
+        }
+
+        /* All data is in place, remaining missing pages are zero. */
+        uffd_unregister_memory(ll->uffd, block->host, block->used_length);
+        trace_ram_lazy_load_block_done(block->idstr);
+    }
+
+    event_notifier_set(&ll->quit);
+    qemu_thread_join(&ll->fault_thread);
+    aio_bh_schedule_oneshot(qemu_get_aio_context(), ram_lazy_load_cleanup_bh,
+                            ll);
+
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static void ram_lazy_load_vm_state_change(void *opaque, bool running,
+                                          RunState state)
+{
+    RAMLazyLoad *ll = opaque;
+
+    if (running) {
+        qemu_mutex_lock(&ll->lock);
+        ll->running = true;
+        qemu_cond_signal(&ll->cond);
+        qemu_mutex_unlock(&ll->lock);
+    }
+}
+
+static RAMLazyLoad *ram_lazy_load_get(QEMUFile *f)
+{
+    QIOChannel *ioc = qemu_file_get_ioc(f);
+    Error *blocker = NULL;
+    RAMLazyLoad *ll;
+    int uffd, fd;
+
+    if (ram_lazy_load) {
+        return ram_lazy_load;
+    }
+
+    if (!object_dynamic_cast(OBJECT(ioc), TYPE_QIO_CHANNEL_FILE)) {
+        return NULL;
+    }
+    error_setg(&blocker, "Lazy restore of the RAM is in progress");
+    if (migrate_add_blocker_internal(&blocker, NULL)) {
+        return NULL;
+    }
+    uffd = uffd_create_fd(0, true);
+    if (uffd < 0) {
+        migrate_del_blocker(&blocker);
+        return NULL;
+    }
+    fd = dup(QIO_CHANNEL_FILE(ioc)->fd);
+    if (fd < 0) {
+        uffd_close_fd(uffd);
+        migrate_del_blocker(&blocker);
+        return NULL;
+    }
+
+    ll = g_new0(RAMLazyLoad, 1);
+    ll->uffd = uffd;
+    ll->fd = fd;
+    ll->blocker = blocker;
+    ll->blocks = g_ptr_array_new();
+    event_notifier_init(&ll->quit, false);
+    qemu_mutex_init(&ll->lock);
+    qemu_cond_init(&ll->cond);
+    ll->vmstate = qemu_add_vm_change_state_handler(
+        ram_lazy_load_vm_state_change, ll);
+    qemu_thread_create(&ll->fault_thread, "mig/dst/lazy-fault",
+                       ram_lazy_load_fault_thread, ll, QEMU_THREAD_JOINABLE);
+    qemu_thread_create(&ll->fill_thread, "mig/dst/lazy-fill",
+                       ram_lazy_load_fill_thread, ll, QEMU_THREAD_DETACHED);
+    ram_lazy_load = ll;
+    return ll;
+}
+
+/*
+ * Try to set up lazy loading of @block, which takes ownership of @bitmap.
+ * Returns false if the block has to be loaded eagerly instead.
+ */
+static bool ram_lazy_load_block(QEMUFile *f, RAMBlock *block,
+                                unsigned long *bitmap)
+{
+    RAMLazyLoadBlock *lb;
+    RAMLazyLoad *ll;
+
+    /*
+     * Other processes mapping shared memory would see the missing pages as
+     * zero, and ROM devices are written directly by QEMU. Devices that
+     * disabled discards, e.g. vfio, may have pinned the current pages.
+     */
+    if (!migrate_lazy_restore() || qemu_ram_is_shared(block) ||
+        block->mr->rom_device || ram_block_discard_is_disabled()) {
+        return false;
+    }
+    ll = ram_lazy_load_get(f);
+    if (!ll) {
+        return false;
+    }
+
+    /*
+     * Anything that was written to the block before loading is replaced by
+     * the contents of the file, drop it so that accesses fault.
+     */
+    if (ram_block_discard_range(block, 0, block->used_length)) {
+        return false;
+    }
+
+    /*
+     * The fault thread must find the block as soon as it is registered. The
+     * fill thread does not look at it before the VM runs, so it is fine to
+     * drop it again if registering fails.
+     */
+    lb = g_new(RAMLazyLoadBlock, 1);
+    lb->rb = block;
+    lb->bmap = bitmap;
+    qemu_mutex_lock(&ll->lock);
+    g_ptr_array_add(ll->blocks, lb);
+    qemu_mutex_unlock(&ll->lock);
+
+    if (uffd_register_memory(ll->uffd, block->host, block->used_length,
+                             UFFDIO_REGISTER_MODE_MISSING, NULL)) {
+        qemu_mutex_lock(&ll->lock);
+        g_ptr_array_remove(ll->blocks, lb);
+        qemu_mutex_unlock(&ll->lock);
+        g_free(lb);
+        return false;
+    }
+    trace_ram_lazy_load_block(block->idstr, block->used_length);
+
+    qemu_mutex_lock(&ll->lock);
+    qemu_cond_signal(&ll->cond);
+    qemu_mutex_unlock(&ll->lock);
+    return true;
+}
+
+/* No more blocks will be set up for lazy loading. */
+static void ram_lazy_load_finish(void)
+{
+    RAMLazyLoad *ll = ram_lazy_load;
+
+    if (!ll) {
+        return;
+    }
+    ram_lazy_load = NULL;
+    qemu_mutex_lock(&ll->lock);
+    ll->load_done = true;
+    qemu_cond_signal(&ll->cond);
+    qemu_mutex_unlock(&ll->lock);
+}
+
+bool ram_lazy_load_available(void)
+{
+    uint64_t uffd_features;
+
+    return uffd_query_features(&uffd_features) == 0;
+}
+#else
+static bool ram_lazy_load_block(QEMUFile *f, RAMBlock *block,
+                                unsigned long *bitmap)
+{
+    return false;
+}
+
+static void ram_lazy_load_finish(void)
+{
+}
+
+bool ram_lazy_load_available(void)
+{
+    return false;
+}
+#endif /* defined(__linux__) */
+
 static bool read_ramblock_mapped_ram(QEMUFile *f, RAMBlock *block,
                                      long num_pages, unsigned long *bitmap,
                                      Error **errp)
@@ -3998,7 +4597,10 @@ static void parse_ramblock_mapped_ram(QEMUFile *f, RAMBlock *block,
         return;
     }
 
-    if (!read_ramblock_mapped_ram(f, block, num_pages, bitmap, errp)) {
+    if (header.page_size == TARGET_PAGE_SIZE &&
+        ram_lazy_load_block(f, block, bitmap)) {
+        bitmap = NULL;
+    } else if (!read_ramblock_mapped_ram(f, block, num_pages, bitmap, errp)) {
         return;
     }
 
@@ -89,6 +89,7 @@ void colo_record_bitmap(RAMBlock *block, ram_addr_t *normal, uint32_t pages);
 /* Background snapshot */
 bool ram_write_tracking_available(void);
 bool ram_write_tracking_compatible(void);
+bool ram_lazy_load_available(void);
 void ram_write_tracking_prepare(void);
 int ram_write_tracking_start(void);
 void ram_write_tracking_stop(void);
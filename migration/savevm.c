@@ -3256,6 +3256,178 @@ void qmp_xen_load_devices_state(const char *filename, Error **errp)
     migration_incoming_state_destroy();
 }
 
+/*
+ * Clone blobs start with the RAM blocks that cannot be shared with the
+ * template, followed by the device state as written by
+ * qemu_save_device_state():
+ *
+ *   be32 CLONE_MAGIC, be32 CLONE_VERSION
+ *   for each migratable RAM block:
+ *     byte CLONE_RAM_SHARED or CLONE_RAM_DATA, counted idstr, be64 length,
+ *     length bytes of contents for CLONE_RAM_DATA
+ *   byte CLONE_RAM_END
+ */
+#define CLONE_MAGIC         0x51434c4e /* "QCLN" */
+#define CLONE_VERSION       1
+#define CLONE_RAM_END       0
+#define CLONE_RAM_DATA      1
+#define CLONE_RAM_SHARED    2
+
+static int clone_save_ram_block(RAMBlock *rb, void *opaque)
+{
+    QEMUFile *f = opaque;
+    const char *idstr = qemu_ram_get_idstr(rb);
+    ram_addr_t length = qemu_ram_get_used_length(rb);
+    bool shared = qemu_ram_is_shared(rb) && qemu_ram_get_fd(rb) >= 0;
+
+    if (!qemu_ram_is_migratable(rb)) {
+        return 0;
+    }
+
+    /*
+     * Memory backends with a shared file are mapped privately by the
+     * clones, everything else (ROMs, VRAM, ...) is small and copied.
+     */
+    qemu_put_byte(f, shared ? CLONE_RAM_SHARED : CLONE_RAM_DATA);
+    qemu_put_counted_string(f, idstr);
+    qemu_put_be64(f, length);
+    if (!shared) {
+        qemu_put_buffer(f, qemu_ram_get_host_addr(rb), length);
+    }
+    trace_clone_save_ram_block(idstr, length, shared);
+    return 0;
+}
+
+void qmp_x_clone_template_save(const char *filename, Error **errp)
+{
+    QEMUFile *f;
+    QIOChannelFile *ioc;
+    int ret;
+
+    /* The clones see the template's memory until they write to it */
+    if (runstate_is_running()) {
+        error_setg(errp, "The template must be paused");
+        return;
+    }
+    global_state_store();
+
+    ioc = qio_channel_file_new_path(filename, O_WRONLY | O_CREAT | O_TRUNC,
+                                    0660, errp);
+    if (!ioc) {
+        return;
+    }
+    qio_channel_set_name(QIO_CHANNEL(ioc), "migration-clone-save");
+    f = qemu_file_new_output(QIO_CHANNEL(ioc));
+    object_unref(OBJECT(ioc));
+
+    qemu_put_be32(f, CLONE_MAGIC);
+    qemu_put_be32(f, CLONE_VERSION);
+    WITH_RCU_READ_LOCK_GUARD() {
+        qemu_ram_foreach_block(clone_save_ram_block, f);
+    }
+    qemu_put_byte(f, CLONE_RAM_END);
+
+    ret = qemu_save_device_state(f);
+    if (ret < 0 || qemu_fclose(f) < 0) {
+        error_setg(errp, "saving clone template state failed");
+    }
+}
+
+static bool clone_load_ram(QEMUFile *f, Error **errp)
+{
+    char idstr[256];
+    uint8_t type;
+
+    if (qemu_get_be32(f) != CLONE_MAGIC ||
+        qemu_get_be32(f) != CLONE_VERSION) {
+        error_setg(errp, "not a clone template file");
+        return false;
+    }
+
+    while ((type = qemu_get_byte(f)) != CLONE_RAM_END) {
+        RAMBlock *rb;
+        uint64_t length;
+
+        if (!qemu_get_counted_string(f, idstr)) {
+            error_setg(errp, "invalid RAM block name");
+            return false;
+        }
+        length = qemu_get_be64(f);
+        rb = qemu_ram_block_by_name(idstr);
+        if (!rb || qemu_ram_get_used_length(rb) != length) {
+            error_setg(errp, "RAM block '%s' does not match the template",
+                       idstr);
+            return false;
+        }
+
+        switch (type) {
+        case CLONE_RAM_DATA:
+            if (qemu_get_buffer(f, qemu_ram_get_host_addr(rb), length) !=
+                length) {
+                error_setg(errp, "short read for RAM block '%s'", idstr);
+                return false;
+            }
+            break;
+        case CLONE_RAM_SHARED:
+            /*
+             * The memory comes from the template's file; a shared mapping
+             * would let the clone corrupt the template.
+             */
+            if (qemu_ram_get_fd(rb) < 0 || qemu_ram_is_shared(rb)) {
+                error_setg(errp, "RAM block '%s' must be a private mapping "
+                           "of the template's memory", idstr);
+                return false;
+            }
+            break;
+        default:
+            error_setg(errp, "unknown RAM block type %d", type);
+            return false;
+        }
+        trace_clone_load_ram_block(idstr, length, type == CLONE_RAM_SHARED);
+    }
+
+    return !qemu_file_get_error_obj(f, errp);
+}
+
+void qmp_x_clone_load(const char *filename, Error **errp)
+{
+    MigrationIncomingState *mis = migration_incoming_get_current();
+    QEMUFile *f;
+    QIOChannelFile *ioc;
+    int ret;
+
+    /*
+     * Like for incoming migration, ROMs must not be written on reset, as
+     * that would copy them into the private mapping of the template's
+     * memory.
+     */
+    if (!runstate_check(RUN_STATE_INMIGRATE) ||
+        mis->state != MIGRATION_STATUS_NONE) {
+        error_setg(errp, "Clone state can only be loaded into a VM started "
+                   "with '-incoming defer'");
+        return;
+    }
+
+    ioc = qio_channel_file_new_path(filename, O_RDONLY | O_BINARY, 0, errp);
+    if (!ioc) {
+        return;
+    }
+    qio_channel_set_name(QIO_CHANNEL(ioc), "migration-clone-load");
+    f = qemu_file_new_input(QIO_CHANNEL(ioc));
+    object_unref(OBJECT(ioc));
+
+    if (clone_load_ram(f, errp)) {
+        ret = qemu_loadvm_state(f);
+        if (ret < 0) {
+            error_setg(errp, "loading clone device state failed");
+        } else {
+            runstate_set(RUN_STATE_PAUSED);
+        }
+    }
+    qemu_fclose(f);
+    migration_incoming_state_destroy();
+}
+
 bool load_snapshot(const char *name, const char *vmstate,
                    bool has_devices, strList *devices, Error **errp)
 {
@@ -187,6 +187,7 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                one-insn-per-tb=on|off (one guest instruction per TCG translation block)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                halt-poll-ns=n (TCG halted vCPU poll time, default 0, disabled)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                eager-split-size=n (KVM Eager Page Split chunk size, default 0, disabled. ARM only)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
@@ -230,6 +231,14 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``halt-poll-ns=n``
+        With multi-threaded TCG, a halted vCPU busy-waits for up to ``n``
+        nanoseconds for a wakeup before putting its thread to sleep. The
+        actual poll time adapts per vCPU to how quickly it was woken up
+        in the past. Polling reduces wakeup latency for guests that idle
+        briefly and often, at the cost of host CPU time. The default is
+        0, which disables polling.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
@@ -4968,11 +4977,11 @@ SRST
 ERST
 
 DEF("trace", HAS_ARG, QEMU_OPTION_trace,
-    "-trace [[enable=]<pattern>][,events=<file>][,file=<file>]\n"
+    "-trace [[enable=]<pattern>][,events=<file>][,file=<file>][,format=simple|ctf]\n"
     "                specify tracing options\n",
     QEMU_ARCH_ALL)
 SRST
-``-trace [[enable=]pattern][,events=file][,file=file]``
+``-trace [[enable=]pattern][,events=file][,file=file][,format=simple|ctf]``
   .. include:: ../qemu-option-trace.rst.inc
 
 ERST
@@ -5240,6 +5249,29 @@ SRST
 
         The ``share`` boolean option is on by default with memfd.
 
+    ``-object memory-backend-pool,id=id,path=path,hugetlbsize=size,fallback=on|off,merge=on|off,dump=on|off,share=on|off,prealloc=on|off,size=size,host-nodes=host-nodes,policy=default|preferred|bind|interleave``
+        Creates a memory backend object that gets its memory from a
+        host-wide pool of pre-zeroed huge pages. QEMU connects to the pool
+        daemon listening on the Unix domain socket ``path`` and receives a
+        memfd with already populated pages, so guest startup time does not
+        depend on the amount of RAM. The memory is handed back to the pool,
+        which clears it in the background, when the object is destroyed or
+        QEMU exits.
+
+        The ``hugetlbsize`` option specifies the huge page size to request
+        (the system default if not set). If ``fallback`` is on (the
+        default), QEMU allocates the memory itself when the pool cannot be
+        reached or cannot satisfy the request, like ``memory-backend-memfd``
+        without ``hugetlb``. The protocol spoken with the pool daemon is
+        described in ``docs/interop/memory-backend-pool.rst``.
+
+        Please refer to ``memory-backend-file`` for a description of the
+        other options.
+
+        The ``share`` boolean option is on by default with pool. Setting it
+        to off will cause a failure during allocation because it is not
+        supported by this backend.
+
     ``-object memory-backend-shm,id=id,merge=on|off,dump=on|off,share=on|off,prealloc=on|off,size=size,host-nodes=host-nodes,policy=default|preferred|bind|interleave``
         Creates a POSIX shared memory backend object, which allows
         QEMU to share the memory with an external process (e.g. when
@@ -5334,7 +5366,7 @@ SRST
         recommended that a persistent set of parameters be generated up
         front and saved.
 
-    ``-object tls-creds-x509,id=id,endpoint=endpoint,dir=/path/to/cred/dir,priority=priority,verify-peer=on|off,passwordid=id``
+    ``-object tls-creds-x509,id=id,endpoint=endpoint,dir=/path/to/cred/dir,priority=priority,verify-peer=on|off,passwordid=id,ktls=on|off``
         Creates a TLS anonymous credentials object, which can be used to
         provide TLS support on network backends. The ``id`` parameter is
         a unique ID which network backends will use to access the
@@ -5378,6 +5410,17 @@ SRST
         string as described at
         https://gnutls.org/manual/html_node/Priority-Strings.html.
 
+        If ``ktls`` is enabled (the default is off), then once the
+        handshake over a TCP socket is completed, the session keys are
+        handed to the Linux kernel TLS layer and record encryption and
+        decryption happen in the kernel rather than in gnutls. This is
+        available for sessions using AES-GCM or ChaCha20-Poly1305
+        ciphers; otherwise gnutls keeps handling the session. Session
+        tickets are disabled on credentials with ``ktls`` enabled, since
+        post-handshake messages cannot be processed once the kernel owns
+        the session. This option is accepted by all ``tls-creds-*``
+        objects.
+
     ``-object tls-cipher-suites,id=id,priority=priority``
         Creates a TLS cipher suites object, which can be used to control
         the TLS cipher/protocol algorithms that applications are permitted
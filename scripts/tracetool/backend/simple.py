@@ -12,6 +12,8 @@
 __email__      = "stefanha@redhat.com"
 
 
+import re
+
 from tracetool import out
 
 
@@ -27,6 +29,28 @@ def is_string(arg):
         return False
 
 
+def is_signed(arg):
+    return re.match(r'(const\s+)?(signed\b|int\b|long\b|short\b|char\b|'
+                    r'int\d+_t\b|ssize_t\b|off_t\b|intptr_t\b)',
+                    arg.lstrip()) is not None
+
+
+def ctf_fields(event):
+    """CTF declaration of the arguments, in the order of the record"""
+    fields = []
+    for type_, name in event.args:
+        if is_string(type_):
+            fields.append('uint32_t _%(name)s_len; utf8_t _%(name)s[_%(name)s_len];'
+                          % {'name': name})
+        elif type_.endswith('*'):
+            fields.append('ptr_t _%s;' % name)
+        elif is_signed(type_):
+            fields.append('int64_t _%s;' % name)
+        else:
+            fields.append('uint64_t _%s;' % name)
+    return ' '.join(fields)
+
+
 def generate_h_begin(events, group):
     for event in events:
         out('void _simple_%(api)s(%(args)s);',
@@ -109,3 +133,22 @@ def generate_c(event, group):
     out('    trace_record_finish(&rec);',
         '}',
         '')
+
+
+def generate_c_end(events, group):
+    out('static const SimpleTraceEventFields _simple_%(group)s_fields[] = {',
+        group=group.lower())
+    for event in events:
+        out('    { &%(event_obj)s, "%(fields)s" },',
+            event_obj=event.api(event.QEMU_EVENT),
+            fields=ctf_fields(event))
+    out('    { NULL, NULL },',
+        '};',
+        '',
+        # Must be registered before the events, see st_init_group()
+        'static void __attribute__((constructor))',
+        '_simple_%(group)s_register_fields(void)',
+        '{',
+        '    st_register_event_fields(_simple_%(group)s_fields);',
+        '}',
+        group=group.lower())
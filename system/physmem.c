@@ -2124,6 +2124,7 @@ static void reclaim_ramblock(RAMBlock *block)
         ram_block_discard_require(false);
     }
 
+    g_free(block->freemap);
     g_free(block);
 }
 
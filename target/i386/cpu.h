@@ -2467,6 +2467,15 @@ static inline int cpu_mmu_index_kernel(CPUX86State *env)
 #include "hw/i386/apic.h"
 #endif
 
+/*
+ * The TB cs_base holds the CS segment base in its low 32 bits (zero in
+ * 64-bit mode) and the CC_OP at TB entry above that.  Keying TBs on the
+ * entry CC_OP lets the translator keep lazy flags evaluation static
+ * across TB boundaries instead of starting each TB from CC_OP_DYNAMIC.
+ */
+#define TB_CS_BASE_CC_OP_SHIFT  32
+#define TB_CS_BASE_MASK         0xffffffffULL
+
 static inline void cpu_get_tb_cpu_state(CPUX86State *env, vaddr *pc,
                                         uint64_t *cs_base, uint32_t *flags)
 {
@@ -2479,6 +2488,7 @@ static inline void cpu_get_tb_cpu_state(CPUX86State *env, vaddr *pc,
         *cs_base = env->segs[R_CS].base;
         *pc = (uint32_t)(*cs_base + env->eip);
     }
+    *cs_base |= (uint64_t)env->cc_op << TB_CS_BASE_CC_OP_SHIFT;
 }
 
 void do_cpu_init(X86CPU *cpu);
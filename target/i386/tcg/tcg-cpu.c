@@ -56,7 +56,7 @@ static void x86_cpu_synchronize_from_tb(CPUState *cs,
         if (tb->flags & HF_CS64_MASK) {
             env->eip = tb->pc;
         } else {
-            env->eip = (uint32_t)(tb->pc - tb->cs_base);
+            env->eip = (uint32_t)(tb->pc - (tb->cs_base & TB_CS_BASE_MASK));
         }
     }
 }
@@ -68,6 +68,7 @@ static void x86_restore_state_to_opc(CPUState *cs,
     X86CPU *cpu = X86_CPU(cs);
     CPUX86State *env = &cpu->env;
     int cc_op = data[1];
+    uint64_t cs_base = tb->cs_base & TB_CS_BASE_MASK;
     uint64_t new_pc;
 
     if (tb_cflags(tb) & CF_PCREL) {
@@ -77,7 +78,7 @@ static void x86_restore_state_to_opc(CPUState *cs,
          * stay the same across the translation block.  Add the CS base back before
          * replacing the low bits, and subtract it below just like for !CF_PCREL.
          */
-        uint64_t pc = env->eip + tb->cs_base;
+        uint64_t pc = env->eip + cs_base;
         new_pc = (pc & TARGET_PAGE_MASK) | data[0];
     } else {
         new_pc = data[0];
@@ -85,7 +86,7 @@ static void x86_restore_state_to_opc(CPUState *cs,
     if (tb->flags & HF_CS64_MASK) {
         env->eip = new_pc;
     } else {
-        env->eip = (uint32_t)(new_pc - tb->cs_base);
+        env->eip = (uint32_t)(new_pc - cs_base);
     }
 
     if (cc_op != CC_OP_DYNAMIC) {
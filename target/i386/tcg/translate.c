@@ -2182,6 +2182,14 @@ static void gen_jmp_rel(DisasContext *s, MemOp ot, int diff, int tb_num)
 
     assert(!s->cc_op_dirty);
 
+    /*
+     * The destination TB is specialized on the CC_OP at its entry, so a
+     * direct jump may only be chained if that CC_OP is known here.
+     */
+    if (s->cc_op == CC_OP_DYNAMIC) {
+        use_goto_tb = false;
+    }
+
     /* In 64-bit mode, operand size is fixed at 64 bits. */
     if (!CODE64(s)) {
         if (ot == MO_16) {
@@ -3882,7 +3890,7 @@ static void i386_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cpu)
     int cpl = (flags >> HF_CPL_SHIFT) & 3;
     int iopl = (flags >> IOPL_SHIFT) & 3;
 
-    dc->cs_base = dc->base.tb->cs_base;
+    dc->cs_base = dc->base.tb->cs_base & TB_CS_BASE_MASK;
     dc->pc_save = dc->base.pc_next;
     dc->flags = flags;
 #ifndef CONFIG_USER_ONLY
@@ -3903,7 +3911,8 @@ static void i386_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cpu)
     g_assert(SVME(dc) == ((flags & HF_SVME_MASK) != 0));
     g_assert(GUEST(dc) == ((flags & HF_GUEST_MASK) != 0));
 
-    dc->cc_op = CC_OP_DYNAMIC;
+    /* env->cc_op at entry is part of the TB key, see cpu_get_tb_cpu_state */
+    dc->cc_op = dc->base.tb->cs_base >> TB_CS_BASE_CC_OP_SHIFT;
     dc->cc_op_dirty = false;
     /* select memory access functions */
     dc->mem_index = cpu_mmu_index(cpu, false);
@@ -71,6 +71,7 @@ static const struct TypeExcp excp_names[] = {
     {EXCCODE_BCE, "Bound Check Exception"},
     {EXCCODE_SXD, "128 bit vector instructions Disable exception"},
     {EXCCODE_ASXD, "256 bit vector instructions Disable exception"},
+    {EXCCODE_GSPR, "Guest privileged error"},
     {EXCCODE_HVC, "Hypervisor call"},
     {EXCP_HLT, "EXCP_HLT"},
 };
@@ -220,6 +221,10 @@ static void loongarch_cpu_do_interrupt(CPUState *cs)
     case EXCCODE_PPI:
         cause = cs->exception_index;
         break;
+    case EXCCODE_GSPR:
+        /* Guest CSR access exit, BADI holds the instruction */
+        cause = cs->exception_index;
+        break;
     case EXCCODE_HVC:
         /* Hypervisor call exception */
         if (is_guest_mode(env)) {
@@ -573,6 +578,7 @@ static void loongarch_cpu_reset_hold(Object *obj, ResetType type)
 
 #ifndef CONFIG_USER_ONLY
     env->pc = 0x1c000000;
+    env->stealtime.guest_addr = 0;
 #ifdef CONFIG_TCG
     memset(env->tlb, 0, sizeof(env->tlb));
     
@@ -785,6 +791,40 @@ static void loongarch_set_lvz(Object *obj, bool value, Error **errp)
     }
 }
 
+static bool loongarch_get_hptw(Object *obj, Error **errp)
+{
+    LoongArchCPU *cpu = LOONGARCH_CPU(obj);
+
+    return FIELD_EX32(cpu->env.cpucfg[2], CPUCFG2, HPTW);
+}
+
+static void loongarch_set_hptw(Object *obj, bool value, Error **errp)
+{
+    LoongArchCPU *cpu = LOONGARCH_CPU(obj);
+
+    if (value && !tcg_enabled()) {
+        error_setg(errp, "'hptw' is only supported with TCG");
+        return;
+    }
+    cpu->env.cpucfg[2] = FIELD_DP32(cpu->env.cpucfg[2], CPUCFG2, HPTW, value);
+}
+
+static bool loongarch_get_pv_ipi(Object *obj, Error **errp)
+{
+    return LOONGARCH_CPU(obj)->pv_ipi;
+}
+
+static void loongarch_set_pv_ipi(Object *obj, bool value, Error **errp)
+{
+    LoongArchCPU *cpu = LOONGARCH_CPU(obj);
+
+    if (value && !tcg_enabled()) {
+        error_setg(errp, "'pv-ipi' is only supported with TCG");
+        return;
+    }
+    cpu->pv_ipi = value;
+}
+
 void loongarch_cpu_post_init(Object *obj)
 {
     object_property_add_bool(obj, "lsx", loongarch_get_lsx,
@@ -793,6 +833,10 @@ void loongarch_cpu_post_init(Object *obj)
                              loongarch_set_lasx);
     object_property_add_bool(obj, "lvz", loongarch_get_lvz,
                              loongarch_set_lvz);
+    object_property_add_bool(obj, "pv-ipi", loongarch_get_pv_ipi,
+                             loongarch_set_pv_ipi);
+    object_property_add_bool(obj, "hptw", loongarch_get_hptw,
+                             loongarch_set_hptw);
 }
 
 static void loongarch_cpu_init(Object *obj)
@@ -113,7 +113,8 @@ FIELD(FCSR0, CAUSE, 24, 5)
 #define  EXCCODE_WPEM                EXCODE(19, 1)
 #define  EXCCODE_BTD                 EXCODE(20, 0)
 #define  EXCCODE_BTE                 EXCODE(21, 0)
-#define  EXCCODE_HVC                 EXCODE(22, 0) /* Hypervisor call */
+#define  EXCCODE_GSPR                EXCODE(22, 0) /* Guest privileged error */
+#define  EXCCODE_HVC                 EXCODE(23, 0) /* Hypervisor call */
 #define  EXCCODE_DBP                 EXCODE(26, 0) /* Reserved subcode used for debug */
 
 /* VM exit reason codes for LVZ */
@@ -169,6 +170,7 @@ FIELD(CPUCFG2, LBT_ARM, 19, 1)
 FIELD(CPUCFG2, LBT_MIPS, 20, 1)
 FIELD(CPUCFG2, LSPW, 21, 1)
 FIELD(CPUCFG2, LAM, 22, 1)
+FIELD(CPUCFG2, HPTW, 24, 1)
 
 /* cpucfg[3] bits */
 FIELD(CPUCFG3, CCDMA, 0, 1)
@@ -237,6 +239,24 @@ FIELD(CPUCFG20, L3IU_WAYS, 0, 16)
 FIELD(CPUCFG20, L3IU_SETS, 16, 8)
 FIELD(CPUCFG20, L3IU_SIZE, 24, 7)
 
+/*
+ * Paravirtual interface shared with Linux guests, identical to the one
+ * offered by KVM: CPUCFG words starting at CPUCFG_KVM_BASE advertise the
+ * hypervisor and its features, and HVCL KVM_HCALL_SERVICE with the
+ * function number in a0 requests a service.
+ */
+#define CPUCFG_KVM_BASE          0x40000000
+#define CPUCFG_KVM_SIG           (CPUCFG_KVM_BASE + 0)
+#define  KVM_SIGNATURE           0x004d564b /* "KVM\0" */
+#define CPUCFG_KVM_FEATURE       (CPUCFG_KVM_BASE + 4)
+#define  KVM_FEATURE_IPI         1
+#define  KVM_FEATURE_STEAL_TIME  2
+
+#define KVM_HCALL_SERVICE        0x100
+#define  KVM_HCALL_FUNC_IPI      1
+#define KVM_HCALL_SUCCESS        0
+#define KVM_HCALL_INVALID_CODE   -1ULL
+
 /*CSR_CRMD */
 FIELD(CSR_CRMD, PLV, 0, 2)
 FIELD(CSR_CRMD, IE, 2, 1)
@@ -250,6 +270,7 @@ extern const char * const regnames[32];
 extern const char * const fregnames[32];
 
 #define N_IRQS      13
+#define IRQ_SWI0    0
 #define IRQ_TIMER   11
 #define IRQ_IPI     12
 
@@ -450,6 +471,15 @@ typedef struct CPUArchState {
     VMExitContext vm_exit_ctx;  /* VM exit context */
     bool lvz_enabled;           /* LVZ virtualization enabled flag */
 
+    /*
+     * Guest physical address of the paravirtual steal time area, as
+     * registered by the guest; the area itself, including the preempted
+     * flag, is maintained by KVM.
+     */
+    struct {
+        uint64_t guest_addr;
+    } stealtime;
+
 #ifdef CONFIG_TCG
     float_status fp_status;
     uint32_t fcsr0_mask;
@@ -484,6 +514,8 @@ struct ArchCPU {
     CPULoongArchState env;
     QEMUTimer timer;
     uint32_t  phy_id;
+    /* Service paravirtual IPI hypercalls from a TCG guest */
+    bool pv_ipi;
 
     /* 'compatible' string for this CPU for Linux device trees */
     const char *dtb_compatible;
@@ -550,6 +582,7 @@ static inline void set_pc(CPULoongArchState *env, uint64_t value)
 #define HW_FLAGS_CRMD_PG    R_CSR_CRMD_PG_MASK   /* 0x10 */
 #define HW_FLAGS_VA32       0x20
 #define HW_FLAGS_EUEN_ASXE  0x40
+#define HW_FLAGS_GUEST      0x80
 
 static inline void cpu_get_tb_cpu_state(CPULoongArchState *env, vaddr *pc,
                                         uint64_t *cs_base, uint32_t *flags)
@@ -561,6 +594,10 @@ static inline void cpu_get_tb_cpu_state(CPULoongArchState *env, vaddr *pc,
     *flags |= FIELD_EX64(env->CSR_EUEN, CSR_EUEN, SXE) * HW_FLAGS_EUEN_SXE;
     *flags |= FIELD_EX64(env->CSR_EUEN, CSR_EUEN, ASXE) * HW_FLAGS_EUEN_ASXE;
     *flags |= is_va32(env) * HW_FLAGS_VA32;
+    if (FIELD_EX32(env->cpucfg[2], CPUCFG2, LVZ) &&
+        FIELD_EX64(env->CSR_GSTAT, CSR_GSTAT, VM)) {
+        *flags |= HW_FLAGS_GUEST;
+    }
 }
 
 #include "exec/cpu-all.h"
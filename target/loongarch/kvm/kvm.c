@@ -585,6 +585,49 @@ static int kvm_loongarch_put_cpucfg(CPUState *cs)
     return ret;
 }
 
+static int kvm_loongarch_get_stealtime(CPUState *cs)
+{
+    int ret;
+    CPULoongArchState *env = cpu_env(cs);
+    struct kvm_device_attr attr = {
+        .group = KVM_LOONGARCH_VCPU_PVTIME_CTRL,
+        .attr = KVM_LOONGARCH_VCPU_PVTIME_GPA,
+        .addr = (uint64_t)&env->stealtime.guest_addr,
+    };
+
+    /* Older kernels do not implement steal time */
+    if (kvm_vcpu_ioctl(cs, KVM_HAS_DEVICE_ATTR, &attr)) {
+        return 0;
+    }
+
+    ret = kvm_vcpu_ioctl(cs, KVM_GET_DEVICE_ATTR, &attr);
+    if (ret < 0) {
+        trace_kvm_failed_get_stealtime(strerror(errno));
+    }
+    return ret;
+}
+
+static int kvm_loongarch_put_stealtime(CPUState *cs)
+{
+    int ret;
+    CPULoongArchState *env = cpu_env(cs);
+    struct kvm_device_attr attr = {
+        .group = KVM_LOONGARCH_VCPU_PVTIME_CTRL,
+        .attr = KVM_LOONGARCH_VCPU_PVTIME_GPA,
+        .addr = (uint64_t)&env->stealtime.guest_addr,
+    };
+
+    if (kvm_vcpu_ioctl(cs, KVM_HAS_DEVICE_ATTR, &attr)) {
+        return 0;
+    }
+
+    ret = kvm_vcpu_ioctl(cs, KVM_SET_DEVICE_ATTR, &attr);
+    if (ret < 0) {
+        trace_kvm_failed_put_stealtime(strerror(errno));
+    }
+    return ret;
+}
+
 int kvm_arch_get_registers(CPUState *cs)
 {
     int ret;
@@ -610,6 +653,11 @@ int kvm_arch_get_registers(CPUState *cs)
     }
 
     ret = kvm_loongarch_get_mpstate(cs);
+    if (ret) {
+        return ret;
+    }
+
+    ret = kvm_loongarch_get_stealtime(cs);
     return ret;
 }
 
@@ -638,6 +686,17 @@ int kvm_arch_put_registers(CPUState *cs, int level)
     }
 
     ret = kvm_loongarch_put_mpstate(cs);
+    if (ret) {
+        return ret;
+    }
+
+    /*
+     * The steal time area only changes when the guest registers it, so
+     * only write it back on reset and after migration.
+     */
+    if (level >= KVM_PUT_RESET_STATE) {
+        ret = kvm_loongarch_put_stealtime(cs);
+    }
     return ret;
 }
 
@@ -110,6 +110,25 @@ static const VMStateDescription vmstate_lasx = {
     },
 };
 
+static bool stealtime_needed(void *opaque)
+{
+    LoongArchCPU *cpu = opaque;
+
+    return cpu->env.stealtime.guest_addr != 0;
+}
+
+/* Paravirtual steal time */
+static const VMStateDescription vmstate_stealtime = {
+    .name = "cpu/stealtime",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = stealtime_needed,
+    .fields = (const VMStateField[]) {
+        VMSTATE_UINT64(env.stealtime.guest_addr, LoongArchCPU),
+        VMSTATE_END_OF_LIST()
+    },
+};
+
 #if defined(CONFIG_TCG) && !defined(CONFIG_USER_ONLY)
 static bool tlb_needed(void *opaque)
 {
@@ -335,6 +354,7 @@ const VMStateDescription vmstate_loongarch_cpu = {
         &vmstate_fpu,
         &vmstate_lsx,
         &vmstate_lasx,
+        &vmstate_stealtime,
 #if defined(CONFIG_TCG) && !defined(CONFIG_USER_ONLY)
         &vmstate_tlb,
         &vmstate_lvz,
@@ -98,431 +98,296 @@ target_ulong helper_csrwr_ticlr(CPULoongArchState *env, target_ulong val)
 
 /* LVZ CSR Access Helper Functions */
 
-/* Helper function to check CSR access permissions in virtualization mode */
-static bool check_csr_access_permission(CPULoongArchState *env, uint32_t csr, bool is_write)
+/*
+ * Guest copies of the CSRs with side effects.  They mirror the host
+ * helpers above, but act on the GCSR_* registers.
+ */
+static target_ulong lvz_gcsrrd_pgd(CPULoongArchState *env)
 {
-    /* If not in guest mode, allow all CSR access */
-    if (!is_guest_mode(env)) {
-        return true;
+    int64_t v;
+
+    if (env->GCSR_TLBRERA & 0x1) {
+        v = env->GCSR_TLBRBADV;
+    } else {
+        v = env->GCSR_BADV;
     }
-    
-    /* In guest mode, check if LVZ is supported */
-    if (!has_lvz_capability(env)) {
-        return false;
+
+    if ((v >> 63) & 0x1) {
+        v = env->GCSR_PGDH;
+    } else {
+        v = env->GCSR_PGDL;
     }
-    
-    /* Check access permissions based on CSR number and guest configuration */
-    switch (csr) {
-    /* Standard CSRs that guests can access */
-    case LOONGARCH_CSR_CRMD:
-    case LOONGARCH_CSR_PRMD:
-    case LOONGARCH_CSR_EUEN:
-    case LOONGARCH_CSR_MISC:
-    case LOONGARCH_CSR_ECFG:
-    case LOONGARCH_CSR_ERA:
-    case LOONGARCH_CSR_BADV:
-    case LOONGARCH_CSR_BADI:
-    case LOONGARCH_CSR_EENTRY:
-        return true;
-        
-    /* TLB-related CSRs */
-    case LOONGARCH_CSR_TLBIDX:
-    case LOONGARCH_CSR_TLBEHI:
-    case LOONGARCH_CSR_TLBELO0:
-    case LOONGARCH_CSR_TLBELO1:
-    case LOONGARCH_CSR_ASID:
-    case LOONGARCH_CSR_PGDL:
-    case LOONGARCH_CSR_PGDH:
-    case LOONGARCH_CSR_PGD:
-    case LOONGARCH_CSR_PWCL:
-    case LOONGARCH_CSR_PWCH:
-    case LOONGARCH_CSR_STLBPS:
-    case LOONGARCH_CSR_RVACFG:
-        return true;
-        
-    /* Timer-related CSRs - check guest config */
-    case LOONGARCH_CSR_TID:
-    case LOONGARCH_CSR_TCFG:
-    case LOONGARCH_CSR_TVAL:
-    case LOONGARCH_CSR_CNTC:
-        if (is_write) {
-            return FIELD_EX64(env->CSR_GCFG, CSR_GCFG, TITO);
-        } else {
-            return FIELD_EX64(env->CSR_GCFG, CSR_GCFG, TITP);
-        }
-        
-    case LOONGARCH_CSR_TICLR:
-        /* Timer clear always needs hypervisor intervention */
-        return false;
-        
-    /* Interrupt-related CSRs - check guest config */
-    case LOONGARCH_CSR_ESTAT:
-        if (is_write) {
-            return FIELD_EX64(env->CSR_GCFG, CSR_GCFG, SITO);
-        } else {
-            return FIELD_EX64(env->CSR_GCFG, CSR_GCFG, SITP);
-        }
-        
-    /* Configuration CSRs */
-    case LOONGARCH_CSR_CPUID:
-    case LOONGARCH_CSR_PRCFG1:
-    case LOONGARCH_CSR_PRCFG2:
-    case LOONGARCH_CSR_PRCFG3:
-        return !is_write; /* Read-only for guests */
-        
-    /* Save registers */
-    case LOONGARCH_CSR_SAVE(0) ... LOONGARCH_CSR_SAVE(15):
-        return true;
-        
-    /* LLB control */
-    case LOONGARCH_CSR_LLBCTL:
-        return true;
-        
-    /* Privileged CSRs that require VM exit */
-    case LOONGARCH_CSR_TLBRENTRY:
-    case LOONGARCH_CSR_TLBRBADV:
-    case LOONGARCH_CSR_TLBRERA:
-    case LOONGARCH_CSR_TLBRSAVE:
-    case LOONGARCH_CSR_TLBRELO0:
-    case LOONGARCH_CSR_TLBRELO1:
-    case LOONGARCH_CSR_TLBREHI:
-    case LOONGARCH_CSR_TLBRPRMD:
-    case LOONGARCH_CSR_MERRCTL:
-    case LOONGARCH_CSR_MERRINFO1:
-    case LOONGARCH_CSR_MERRINFO2:
-    case LOONGARCH_CSR_MERRENTRY:
-    case LOONGARCH_CSR_MERRERA:
-    case LOONGARCH_CSR_MERRSAVE:
-    case LOONGARCH_CSR_CTAG:
-        return false; /* Require VM exit */
-        
-    /* Direct mapping windows - check guest config */
-    case LOONGARCH_CSR_DMW(0) ... LOONGARCH_CSR_DMW(3):
-        return true; /* Allow guest access with proper config */
-        
-    /* Implementation dependent CSRs */
-    case LOONGARCH_CSR_IMPCTL1:
-    case LOONGARCH_CSR_IMPCTL2:
-        return false; /* Usually require VM exit */
-        
-    /* Debug CSRs */
-    case LOONGARCH_CSR_DBG:
-    case LOONGARCH_CSR_DERA:
-    case LOONGARCH_CSR_DSAVE:
-        return false; /* Debug CSRs require hypervisor privilege */
-        
-    default:
-        /* Unknown CSR, deny access */
-        return false;
+
+    return v;
+}
+
+static target_ulong lvz_gcsrwr_estat(CPULoongArchState *env, target_ulong val)
+{
+    int64_t old_v = env->GCSR_ESTAT;
+
+    /* Only IS[1:0] can be written */
+    env->GCSR_ESTAT = deposit64(env->GCSR_ESTAT, 0, 2, val);
+
+    return old_v;
+}
+
+static target_ulong lvz_gcsrwr_asid(CPULoongArchState *env, target_ulong val)
+{
+    int64_t old_v = env->GCSR_ASID;
+
+    /* Only the ASID field can be written */
+    env->GCSR_ASID = deposit64(env->GCSR_ASID, 0, 10, val);
+    if (old_v != env->GCSR_ASID) {
+        tlb_flush(env_cpu(env));
     }
+    return old_v;
 }
 
-/* Trigger VM exit for CSR access that requires hypervisor intervention */
-static void trigger_csr_vm_exit(CPULoongArchState *env, uint32_t csr, bool is_write, target_ulong val)
+static target_ulong lvz_gcsrwr_ticlr(CPULoongArchState *env, target_ulong val)
 {
-    (void)csr;   /* CSR number for hypervisor */
-    (void)val;   /* Value for write operations */
-    (void)is_write;
-    
-    /* Store CSR information for hypervisor */
-    /* In a full implementation, the hypervisor would need access to:
-     * - CSR number
-     * - Access type (read/write)
-     * - Value being written (for writes)
-     * - Guest PC at time of access
-     */
-    
-    /* Set VM mode to exit to hypervisor */
-    env->CSR_GSTAT = FIELD_DP64(env->CSR_GSTAT, CSR_GSTAT, VM, 0);
-    
-    /* Generate hypervisor exception */
-    do_raise_exception(env, EXCCODE_HVC, GETPC());
+    if (val & 0x1) {
+        env->GCSR_ESTAT = deposit64(env->GCSR_ESTAT, IRQ_TIMER, 1, 0);
+    }
+    return 0;
 }
 
-/* Enhanced CSR read function with LVZ support */
-target_ulong helper_csrrd_with_lvz(CPULoongArchState *env, uint32_t csr)
+/*
+ * Guest access rules for each CSR.  In guest mode every CSR instruction
+ * accesses the guest copy, GCSR_*, of the register, as the TLB
+ * instructions do.  Permissions that depend on the guest configuration
+ * name the GCFG fields granting them; copies with side effects have
+ * read/write functions.  A CSR that is absent from the table, or whose
+ * access is not granted, raises a GSPR exit to the hypervisor.
+ *
+ * Guest accesses that are always granted and have no side effects are
+ * resolved at translate time; only CSRs marked CSRFL_LVZ in the
+ * translator's csr_info table, or that have host read/write helpers,
+ * reach these helpers.
+ */
+enum {
+    LVZ_CSR_RD      = (1 << 0),  /* Guest may read */
+    LVZ_CSR_WR      = (1 << 1),  /* Guest may write */
+    LVZ_CSR_GCFG_TI = (1 << 2),  /* ...if GCFG.TITP (read) / TITO (write) */
+    LVZ_CSR_GCFG_SI = (1 << 3),  /* ...if GCFG.SITP (read) / SITO (write) */
+};
+
+typedef struct LVZCSRInfo {
+    int offset;
+    int flags;
+    target_ulong (*readfn)(CPULoongArchState *env);
+    target_ulong (*writefn)(CPULoongArchState *env, target_ulong val);
+} LVZCSRInfo;
+
+#define LVZ_CSR_FUNCS(NAME, FL, RD, WR)                     \
+    [LOONGARCH_CSR_##NAME] = {                              \
+        .offset = offsetof(CPULoongArchState, GCSR_##NAME), \
+        .flags = FL, .readfn = RD, .writefn = WR            \
+    }
+
+#define LVZ_CSR_ARRAY(NAME, N)                                 \
+    [LOONGARCH_CSR_##NAME(N)] = {                              \
+        .offset = offsetof(CPULoongArchState, GCSR_##NAME[N]), \
+        .flags = LVZ_CSR_RD | LVZ_CSR_WR                       \
+    }
+
+#define LVZ_CSR(NAME, FL) \
+    LVZ_CSR_FUNCS(NAME, FL, NULL, NULL)
+
+#define LVZ_CSR_RW(NAME) \
+    LVZ_CSR(NAME, LVZ_CSR_RD | LVZ_CSR_WR)
+
+#define LVZ_CSR_TI      (LVZ_CSR_RD | LVZ_CSR_WR | LVZ_CSR_GCFG_TI)
+
+static const LVZCSRInfo lvz_csr_info[] = {
+    LVZ_CSR_RW(CRMD),
+    LVZ_CSR_RW(PRMD),
+    LVZ_CSR_RW(EUEN),
+    LVZ_CSR_RW(MISC),
+    LVZ_CSR_RW(ECFG),
+    LVZ_CSR_FUNCS(ESTAT, LVZ_CSR_RD | LVZ_CSR_WR | LVZ_CSR_GCFG_SI,
+                  NULL, lvz_gcsrwr_estat),
+    LVZ_CSR_RW(ERA),
+    LVZ_CSR_RW(BADV),
+    LVZ_CSR_RW(BADI),
+    LVZ_CSR_RW(EENTRY),
+    LVZ_CSR_RW(TLBIDX),
+    LVZ_CSR_RW(TLBEHI),
+    LVZ_CSR_RW(TLBELO0),
+    LVZ_CSR_RW(TLBELO1),
+    LVZ_CSR_FUNCS(ASID, LVZ_CSR_RD | LVZ_CSR_WR, NULL, lvz_gcsrwr_asid),
+    LVZ_CSR_RW(PGDL),
+    LVZ_CSR_RW(PGDH),
+    LVZ_CSR_FUNCS(PGD, LVZ_CSR_RD, lvz_gcsrrd_pgd, NULL),
+    LVZ_CSR_RW(PWCL),
+    LVZ_CSR_RW(PWCH),
+    LVZ_CSR_RW(STLBPS),
+    LVZ_CSR_RW(RVACFG),
+    /* Set up by the hypervisor */
+    LVZ_CSR(CPUID, LVZ_CSR_RD),
+    LVZ_CSR(PRCFG1, LVZ_CSR_RD),
+    LVZ_CSR(PRCFG2, LVZ_CSR_RD),
+    LVZ_CSR(PRCFG3, LVZ_CSR_RD),
+    LVZ_CSR_ARRAY(SAVE, 0),
+    LVZ_CSR_ARRAY(SAVE, 1),
+    LVZ_CSR_ARRAY(SAVE, 2),
+    LVZ_CSR_ARRAY(SAVE, 3),
+    LVZ_CSR_ARRAY(SAVE, 4),
+    LVZ_CSR_ARRAY(SAVE, 5),
+    LVZ_CSR_ARRAY(SAVE, 6),
+    LVZ_CSR_ARRAY(SAVE, 7),
+    LVZ_CSR_ARRAY(SAVE, 8),
+    LVZ_CSR_ARRAY(SAVE, 9),
+    LVZ_CSR_ARRAY(SAVE, 10),
+    LVZ_CSR_ARRAY(SAVE, 11),
+    LVZ_CSR_ARRAY(SAVE, 12),
+    LVZ_CSR_ARRAY(SAVE, 13),
+    LVZ_CSR_ARRAY(SAVE, 14),
+    LVZ_CSR_ARRAY(SAVE, 15),
+    LVZ_CSR(TID, LVZ_CSR_TI),
+    LVZ_CSR(TCFG, LVZ_CSR_TI),
+    LVZ_CSR(TVAL, LVZ_CSR_RD | LVZ_CSR_GCFG_TI),
+    LVZ_CSR(CNTC, LVZ_CSR_TI),
+    LVZ_CSR_FUNCS(TICLR, LVZ_CSR_TI, NULL, lvz_gcsrwr_ticlr),
+    LVZ_CSR_RW(LLBCTL),
+    LVZ_CSR_RW(IMPCTL1),
+    LVZ_CSR_RW(IMPCTL2),
+    LVZ_CSR_RW(TLBRENTRY),
+    LVZ_CSR_RW(TLBRBADV),
+    LVZ_CSR_RW(TLBRERA),
+    LVZ_CSR_RW(TLBRSAVE),
+    LVZ_CSR_RW(TLBRELO0),
+    LVZ_CSR_RW(TLBRELO1),
+    LVZ_CSR_RW(TLBREHI),
+    LVZ_CSR_RW(TLBRPRMD),
+    LVZ_CSR_RW(MERRCTL),
+    LVZ_CSR_RW(MERRINFO1),
+    LVZ_CSR_RW(MERRINFO2),
+    LVZ_CSR_RW(MERRENTRY),
+    LVZ_CSR_RW(MERRERA),
+    LVZ_CSR_RW(MERRSAVE),
+    LVZ_CSR_RW(CTAG),
+    LVZ_CSR_ARRAY(DMW, 0),
+    LVZ_CSR_ARRAY(DMW, 1),
+    LVZ_CSR_ARRAY(DMW, 2),
+    LVZ_CSR_ARRAY(DMW, 3),
+    LVZ_CSR_RW(DBG),
+    LVZ_CSR_RW(DERA),
+    LVZ_CSR_RW(DSAVE),
+};
+
+/*
+ * Look up CSR for a guest access, or return NULL if the access must exit
+ * to the hypervisor.
+ */
+static const LVZCSRInfo *get_lvz_csr(CPULoongArchState *env, uint32_t csr,
+                                     bool is_write)
 {
-    /* Check access permission */
-    if (!check_csr_access_permission(env, csr, false)) {
-        trigger_csr_vm_exit(env, csr, false, 0);
-        return 0;
+    const LVZCSRInfo *info;
+    int flags;
+
+    if (csr >= ARRAY_SIZE(lvz_csr_info) || !lvz_csr_info[csr].offset) {
+        return NULL;
+    }
+    info = &lvz_csr_info[csr];
+
+    flags = info->flags;
+    if (!(flags & (is_write ? LVZ_CSR_WR : LVZ_CSR_RD))) {
+        return NULL;
     }
-    
-    /* For guest mode, handle special CSRs */
-    if (is_guest_mode(env)) {
-        switch (csr) {
-        case LOONGARCH_CSR_CPUID:
-            /* Guest sees virtual CPU ID */
-            return helper_csrrd_cpuid(env);
-            
-        case LOONGARCH_CSR_TVAL:
-            /* Timer value adjusted for guest */
-            return helper_csrrd_tval(env);
-            
-        case LOONGARCH_CSR_PGD:
-            /* Page directory base adjusted for guest */
-            return helper_csrrd_pgd(env);
-            
-        default:
-            /* Standard CSR access for guest */
-            break;
-        }
+    if ((flags & LVZ_CSR_GCFG_TI) &&
+        !(is_write ? FIELD_EX64(env->CSR_GCFG, CSR_GCFG, TITO)
+                   : FIELD_EX64(env->CSR_GCFG, CSR_GCFG, TITP))) {
+        return NULL;
     }
-    
-    /* Handle standard CSR reads */
-    switch (csr) {
-    case LOONGARCH_CSR_CRMD:
-        return env->CSR_CRMD;
-    case LOONGARCH_CSR_PRMD:
-        return env->CSR_PRMD;
-    case LOONGARCH_CSR_EUEN:
-        return env->CSR_EUEN;
-    case LOONGARCH_CSR_MISC:
-        return env->CSR_MISC;
-    case LOONGARCH_CSR_ECFG:
-        return env->CSR_ECFG;
-    case LOONGARCH_CSR_ESTAT:
-        return env->CSR_ESTAT;
-    case LOONGARCH_CSR_ERA:
-        return env->CSR_ERA;
-    case LOONGARCH_CSR_BADV:
-        return env->CSR_BADV;
-    case LOONGARCH_CSR_BADI:
-        return env->CSR_BADI;
-    case LOONGARCH_CSR_EENTRY:
-        return env->CSR_EENTRY;
-    case LOONGARCH_CSR_TLBIDX:
-        return env->CSR_TLBIDX;
-    case LOONGARCH_CSR_TLBEHI:
-        return env->CSR_TLBEHI;
-    case LOONGARCH_CSR_TLBELO0:
-        return env->CSR_TLBELO0;
-    case LOONGARCH_CSR_TLBELO1:
-        return env->CSR_TLBELO1;
-    case LOONGARCH_CSR_ASID:
-        return env->CSR_ASID;
-    case LOONGARCH_CSR_PGDL:
-        return env->CSR_PGDL;
-    case LOONGARCH_CSR_PGDH:
-        return env->CSR_PGDH;
-    case LOONGARCH_CSR_PGD:
-        return helper_csrrd_pgd(env);
-    case LOONGARCH_CSR_PWCL:
-        return env->CSR_PWCL;
-    case LOONGARCH_CSR_PWCH:
-        return env->CSR_PWCH;
-    case LOONGARCH_CSR_STLBPS:
-        return env->CSR_STLBPS;
-    case LOONGARCH_CSR_RVACFG:
-        return env->CSR_RVACFG;
-    case LOONGARCH_CSR_CPUID:
-        return helper_csrrd_cpuid(env);
-    case LOONGARCH_CSR_PRCFG1:
-        return env->CSR_PRCFG1;
-    case LOONGARCH_CSR_PRCFG2:
-        return env->CSR_PRCFG2;
-    case LOONGARCH_CSR_PRCFG3:
-        return env->CSR_PRCFG3;
-    case LOONGARCH_CSR_TID:
-        return env->CSR_TID;
-    case LOONGARCH_CSR_TCFG:
-        return env->CSR_TCFG;
-    case LOONGARCH_CSR_TVAL:
-        return helper_csrrd_tval(env);
-    case LOONGARCH_CSR_CNTC:
-        return env->CSR_CNTC;
-    case LOONGARCH_CSR_TICLR:
-        return env->CSR_TICLR;
-    case LOONGARCH_CSR_LLBCTL:
-        return env->CSR_LLBCTL;
-    case LOONGARCH_CSR_IMPCTL1:
-        return env->CSR_IMPCTL1;
-    case LOONGARCH_CSR_IMPCTL2:
-        return env->CSR_IMPCTL2;
-    default:
-        /* Handle SAVE registers */
-        if (csr >= LOONGARCH_CSR_SAVE(0) && csr <= LOONGARCH_CSR_SAVE(15)) {
-            int index = csr - LOONGARCH_CSR_SAVE(0);
-            return env->CSR_SAVE[index];
-        }
-        /* Handle DMW registers */
-        if (csr >= LOONGARCH_CSR_DMW(0) && csr <= LOONGARCH_CSR_DMW(3)) {
-            int index = csr - LOONGARCH_CSR_DMW(0);
-            return env->CSR_DMW[index];
-        }
-        /* Unknown CSR, trigger VM exit */
-        trigger_csr_vm_exit(env, csr, false, 0);
-        return 0;
+    if ((flags & LVZ_CSR_GCFG_SI) &&
+        !(is_write ? FIELD_EX64(env->CSR_GCFG, CSR_GCFG, SITO)
+                   : FIELD_EX64(env->CSR_GCFG, CSR_GCFG, SITP))) {
+        return NULL;
     }
+    return info;
 }
 
-/* Enhanced CSR write function with LVZ support */
-target_ulong helper_csrwr_with_lvz(CPULoongArchState *env, target_ulong val, uint32_t csr)
+static target_ulong lvz_csr_read(CPULoongArchState *env,
+                                 const LVZCSRInfo *info)
 {
+    if (info->readfn) {
+        return info->readfn(env);
+    }
+    return *(uint64_t *)((void *)env + info->offset);
+}
+
+static target_ulong lvz_csr_write(CPULoongArchState *env,
+                                  const LVZCSRInfo *info, target_ulong val)
+{
+    uint64_t *ptr = (uint64_t *)((void *)env + info->offset);
     target_ulong old_val;
-    
-    /* Check access permission */
-    if (!check_csr_access_permission(env, csr, true)) {
-        trigger_csr_vm_exit(env, csr, true, val);
-        return 0;
+
+    if (info->writefn) {
+        return info->writefn(env, val);
     }
-    
-    /* Handle special CSRs that need custom logic */
-    switch (csr) {
-    case LOONGARCH_CSR_ESTAT:
-        return helper_csrwr_estat(env, val);
-    case LOONGARCH_CSR_ASID:
-        return helper_csrwr_asid(env, val);
-    case LOONGARCH_CSR_TCFG:
-        return helper_csrwr_tcfg(env, val);
-    case LOONGARCH_CSR_TICLR:
-        return helper_csrwr_ticlr(env, val);
-    default:
-        break;
+    old_val = *ptr;
+    *ptr = val;
+    return old_val;
+}
+
+/*
+ * The guest accessed a CSR it has no permission for: exit to the
+ * hypervisor with a guest sensitive privileged resource exception.  The
+ * hypervisor decodes the instruction from BADI and finds the access type
+ * in the exit context.
+ */
+static G_NORETURN
+void trigger_csr_vm_exit(CPULoongArchState *env, uint32_t reason,
+                         uintptr_t retaddr)
+{
+    env->vm_exit_ctx.gid = get_guest_id(env);
+    env->vm_exit_ctx.exit_reason = reason;
+    env->vm_exit_ctx.fault_gva = 0;
+    env->vm_exit_ctx.fault_gpa = 0;
+
+    env->CSR_GSTAT = FIELD_DP64(env->CSR_GSTAT, CSR_GSTAT, PVM, 1);
+    env->CSR_GSTAT = FIELD_DP64(env->CSR_GSTAT, CSR_GSTAT, VM, 0);
+
+    do_raise_exception(env, EXCCODE_GSPR, retaddr);
+}
+
+/* Enhanced CSR read function with LVZ support */
+target_ulong helper_csrrd_with_lvz(CPULoongArchState *env, uint32_t csr)
+{
+    const LVZCSRInfo *info = get_lvz_csr(env, csr, false);
+
+    if (!info) {
+        trigger_csr_vm_exit(env, VMEXIT_CSRR, GETPC());
     }
-    
-    /* Standard CSR writes */
-    switch (csr) {
-    case LOONGARCH_CSR_CRMD:
-        old_val = env->CSR_CRMD;
-        env->CSR_CRMD = val;
-        return old_val;
-    case LOONGARCH_CSR_PRMD:
-        old_val = env->CSR_PRMD;
-        env->CSR_PRMD = val;
-        return old_val;
-    case LOONGARCH_CSR_EUEN:
-        old_val = env->CSR_EUEN;
-        env->CSR_EUEN = val;
-        return old_val;
-    case LOONGARCH_CSR_MISC:
-        old_val = env->CSR_MISC;
-        env->CSR_MISC = val;
-        return old_val;
-    case LOONGARCH_CSR_ECFG:
-        old_val = env->CSR_ECFG;
-        env->CSR_ECFG = val;
-        return old_val;
-    case LOONGARCH_CSR_ERA:
-        old_val = env->CSR_ERA;
-        env->CSR_ERA = val;
-        return old_val;
-    case LOONGARCH_CSR_BADV:
-        old_val = env->CSR_BADV;
-        env->CSR_BADV = val;
-        return old_val;
-    case LOONGARCH_CSR_BADI:
-        old_val = env->CSR_BADI;
-        env->CSR_BADI = val;
-        return old_val;
-    case LOONGARCH_CSR_EENTRY:
-        old_val = env->CSR_EENTRY;
-        env->CSR_EENTRY = val;
-        return old_val;
-    case LOONGARCH_CSR_TLBIDX:
-        old_val = env->CSR_TLBIDX;
-        env->CSR_TLBIDX = val;
-        return old_val;
-    case LOONGARCH_CSR_TLBEHI:
-        old_val = env->CSR_TLBEHI;
-        env->CSR_TLBEHI = val;
-        return old_val;
-    case LOONGARCH_CSR_TLBELO0:
-        old_val = env->CSR_TLBELO0;
-        env->CSR_TLBELO0 = val;
-        return old_val;
-    case LOONGARCH_CSR_TLBELO1:
-        old_val = env->CSR_TLBELO1;
-        env->CSR_TLBELO1 = val;
-        return old_val;
-    case LOONGARCH_CSR_PGDL:
-        old_val = env->CSR_PGDL;
-        env->CSR_PGDL = val;
-        return old_val;
-    case LOONGARCH_CSR_PGDH:
-        old_val = env->CSR_PGDH;
-        env->CSR_PGDH = val;
-        return old_val;
-    case LOONGARCH_CSR_PGD:
-        old_val = env->CSR_PGD;
-        env->CSR_PGD = val;
-        return old_val;
-    case LOONGARCH_CSR_PWCL:
-        old_val = env->CSR_PWCL;
-        env->CSR_PWCL = val;
-        return old_val;
-    case LOONGARCH_CSR_PWCH:
-        old_val = env->CSR_PWCH;
-        env->CSR_PWCH = val;
-        return old_val;
-    case LOONGARCH_CSR_STLBPS:
-        old_val = env->CSR_STLBPS;
-        env->CSR_STLBPS = val;
-        return old_val;
-    case LOONGARCH_CSR_RVACFG:
-        old_val = env->CSR_RVACFG;
-        env->CSR_RVACFG = val;
-        return old_val;
-    case LOONGARCH_CSR_TID:
-        old_val = env->CSR_TID;
-        env->CSR_TID = val;
-        return old_val;
-    case LOONGARCH_CSR_CNTC:
-        old_val = env->CSR_CNTC;
-        env->CSR_CNTC = val;
-        return old_val;
-    case LOONGARCH_CSR_LLBCTL:
-        old_val = env->CSR_LLBCTL;
-        env->CSR_LLBCTL = val;
-        return old_val;
-    case LOONGARCH_CSR_IMPCTL1:
-        old_val = env->CSR_IMPCTL1;
-        env->CSR_IMPCTL1 = val;
-        return old_val;
-    case LOONGARCH_CSR_IMPCTL2:
-        old_val = env->CSR_IMPCTL2;
-        env->CSR_IMPCTL2 = val;
-        return old_val;
-    default:
-        /* Handle SAVE registers */
-        if (csr >= LOONGARCH_CSR_SAVE(0) && csr <= LOONGARCH_CSR_SAVE(15)) {
-            int index = csr - LOONGARCH_CSR_SAVE(0);
-            old_val = env->CSR_SAVE[index];
-            env->CSR_SAVE[index] = val;
-            return old_val;
-        }
-        /* Handle DMW registers */
-        if (csr >= LOONGARCH_CSR_DMW(0) && csr <= LOONGARCH_CSR_DMW(3)) {
-            int index = csr - LOONGARCH_CSR_DMW(0);
-            old_val = env->CSR_DMW[index];
-            env->CSR_DMW[index] = val;
-            return old_val;
-        }
-        /* Unknown CSR, trigger VM exit */
-        trigger_csr_vm_exit(env, csr, true, val);
-        return 0;
+    return lvz_csr_read(env, info);
+}
+
+/* Enhanced CSR write function with LVZ support */
+target_ulong helper_csrwr_with_lvz(CPULoongArchState *env, target_ulong val,
+                                   uint32_t csr)
+{
+    const LVZCSRInfo *info = get_lvz_csr(env, csr, true);
+
+    if (!info) {
+        trigger_csr_vm_exit(env, VMEXIT_CSRW, GETPC());
     }
+    return lvz_csr_write(env, info, val);
 }
 
 /* Enhanced CSR exchange function with LVZ support */
-target_ulong helper_csrxchg_with_lvz(CPULoongArchState *env, target_ulong rj, target_ulong rd, uint32_t csr)
+target_ulong helper_csrxchg_with_lvz(CPULoongArchState *env, target_ulong rj,
+                                     target_ulong rd, uint32_t csr)
 {
-    target_ulong old_val, new_val;
-    
-    /* Check access permission */
-    if (!check_csr_access_permission(env, csr, true)) {
-        trigger_csr_vm_exit(env, csr, true, rj);
-        return 0;
+    const LVZCSRInfo *info = get_lvz_csr(env, csr, true);
+    target_ulong old_val;
+
+    /* csrxchg returns the old value, so it needs the read permission too */
+    if (!info || !get_lvz_csr(env, csr, false)) {
+        trigger_csr_vm_exit(env, VMEXIT_CSRX, GETPC());
     }
-    
-    /* First read the current value */
-    old_val = helper_csrrd_with_lvz(env, csr);
-    
-    /* Calculate new value: (old_val & ~rd) | (rj & rd) */
-    new_val = (old_val & ~rd) | (rj & rd);
-    
-    /* Write the new value */
-    helper_csrwr_with_lvz(env, new_val, csr);
-    
+
+    /* The new value is (old_val & ~rd) | (rj & rd) */
+    old_val = lvz_csr_read(env, info);
+    lvz_csr_write(env, info, (old_val & ~rd) | (rj & rd));
     return old_val;
 }
@@ -490,11 +490,55 @@ void helper_gtlbfill(CPULoongArchState *env)
     tlb_flush(env_cpu(env));
 }
 
+/*
+ * Deliver a paravirtual IPI: a1/a2 hold a 128-bit bitmap of target CPUs,
+ * relative to the physical CPU id in a3.  Raising SWI0 on each target is
+ * all that is needed; the guest keeps the IPI action in its own memory.
+ * A multicast IPI therefore costs a single exit instead of one IOCSR
+ * mailbox write per destination.
+ */
+static target_ulong loongarch_pv_send_ipi(CPULoongArchState *env)
+{
+    uint64_t bitmap[2] = { env->gpr[5], env->gpr[6] };
+    uint64_t min = env->gpr[7];
+    CPUState *cs;
+    int i, bit;
+
+    BQL_LOCK_GUARD();
+    for (i = 0; i < ARRAY_SIZE(bitmap); i++) {
+        while (bitmap[i]) {
+            bit = ctz64(bitmap[i]);
+            bitmap[i] &= bitmap[i] - 1;
+
+            cs = cpu_by_arch_id(min + i * 64 + bit);
+            if (cs) {
+                loongarch_cpu_set_irq(LOONGARCH_CPU(cs), IRQ_SWI0, 1);
+            }
+        }
+    }
+    return KVM_HCALL_SUCCESS;
+}
+
+static target_ulong loongarch_pv_hypercall(CPULoongArchState *env)
+{
+    switch (env->gpr[4]) {
+    case KVM_HCALL_FUNC_IPI:
+        return loongarch_pv_send_ipi(env);
+    default:
+        return KVM_HCALL_INVALID_CODE;
+    }
+}
+
 /* Hypervisor call helper */
 void helper_hvcl(CPULoongArchState *env, uint32_t code)
 {
     /* Check if we're in guest mode */
     if (!is_guest_mode(env)) {
+        /* Paravirtual services are handled by QEMU itself */
+        if (env_archcpu(env)->pv_ipi && code == KVM_HCALL_SERVICE) {
+            env->gpr[4] = loongarch_pv_hypercall(env);
+            return;
+        }
         /* HVCL from host mode should be treated as illegal instruction */
         do_raise_exception(env, EXCCODE_INE, GETPC());
         return;
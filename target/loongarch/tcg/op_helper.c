@@ -82,6 +82,20 @@ target_ulong helper_crc32c(target_ulong val, target_ulong m, uint64_t sz)
 
 target_ulong helper_cpucfg(CPULoongArchState *env, target_ulong rj)
 {
+#ifndef CONFIG_USER_ONLY
+    /*
+     * The PV IPI hypercalls are implemented for the OS running on the
+     * emulated CPU only, don't advertise them to LVZ guests.
+     */
+    if (env_archcpu(env)->pv_ipi && !is_guest_mode(env)) {
+        switch (rj) {
+        case CPUCFG_KVM_SIG:
+            return KVM_SIGNATURE;
+        case CPUCFG_KVM_FEATURE:
+            return BIT(KVM_FEATURE_IPI);
+        }
+    }
+#endif
     return rj >= ARRAY_SIZE(env->cpucfg) ? 0 : env->cpucfg[rj];
 }
 
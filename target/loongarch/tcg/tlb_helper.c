@@ -42,6 +42,13 @@ static inline bool tlb_entry_matches_guest(CPULoongArchState *env, LoongArchTLB
     return entry_gid == current_gid;
 }
 
+/*
+ * The CSR NAME as accessed by the TLB instructions: the guest copy in
+ * guest mode, like for the CSR instructions.
+ */
+#define EFFECTIVE_CSR(env, NAME) \
+    (*(is_guest_mode(env) ? &(env)->GCSR_##NAME : &(env)->CSR_##NAME))
+
 /* Get effective CSR values based on virtualization mode */
 static inline uint64_t get_effective_csr_asid(CPULoongArchState *env)
 {
@@ -133,25 +140,25 @@ static void get_dir_base_width(CPULoongArchState *env, uint64_t *dir_base,
 {
     switch (level) {
     case 1:
-        *dir_base = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, DIR1_BASE);
-        *dir_width = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, DIR1_WIDTH);
+        *dir_base = FIELD_EX64(EFFECTIVE_CSR(env, PWCL), CSR_PWCL, DIR1_BASE);
+        *dir_width = FIELD_EX64(EFFECTIVE_CSR(env, PWCL), CSR_PWCL, DIR1_WIDTH);
         break;
     case 2:
-        *dir_base = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, DIR2_BASE);
-        *dir_width = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, DIR2_WIDTH);
+        *dir_base = FIELD_EX64(EFFECTIVE_CSR(env, PWCL), CSR_PWCL, DIR2_BASE);
+        *dir_width = FIELD_EX64(EFFECTIVE_CSR(env, PWCL), CSR_PWCL, DIR2_WIDTH);
         break;
     case 3:
-        *dir_base = FIELD_EX64(env->CSR_PWCH, CSR_PWCH, DIR3_BASE);
-        *dir_width = FIELD_EX64(env->CSR_PWCH, CSR_PWCH, DIR3_WIDTH);
+        *dir_base = FIELD_EX64(EFFECTIVE_CSR(env, PWCH), CSR_PWCH, DIR3_BASE);
+        *dir_width = FIELD_EX64(EFFECTIVE_CSR(env, PWCH), CSR_PWCH, DIR3_WIDTH);
         break;
     case 4:
-        *dir_base = FIELD_EX64(env->CSR_PWCH, CSR_PWCH, DIR4_BASE);
-        *dir_width = FIELD_EX64(env->CSR_PWCH, CSR_PWCH, DIR4_WIDTH);
+        *dir_base = FIELD_EX64(EFFECTIVE_CSR(env, PWCH), CSR_PWCH, DIR4_BASE);
+        *dir_width = FIELD_EX64(EFFECTIVE_CSR(env, PWCH), CSR_PWCH, DIR4_WIDTH);
         break;
     default:
         /* level may be zero for ldpte */
-        *dir_base = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, PTBASE);
-        *dir_width = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, PTWIDTH);
+        *dir_base = FIELD_EX64(EFFECTIVE_CSR(env, PWCL), CSR_PWCL, PTBASE);
+        *dir_width = FIELD_EX64(EFFECTIVE_CSR(env, PWCL), CSR_PWCL, PTWIDTH);
         break;
     }
 }
@@ -237,7 +244,7 @@ static void invalidate_tlb_entry(CPULoongArchState *env, int index)
     if (index >= LOONGARCH_STLB) {
         tlb_ps = FIELD_EX64(tlb->tlb_misc, TLB_MISC, PS);
     } else {
-        tlb_ps = FIELD_EX64(env->CSR_STLBPS, CSR_STLBPS, PS);
+        tlb_ps = FIELD_EX64(EFFECTIVE_CSR(env, STLBPS), CSR_STLBPS, PS);
     }
     pagesize = MAKE_64BIT_MASK(tlb_ps, 1);
     mask = MAKE_64BIT_MASK(0, tlb_ps + 1);
@@ -255,33 +262,11 @@ static void invalidate_tlb_entry(CPULoongArchState *env, int index)
     }
 }
 
-static void fill_tlb_entry(CPULoongArchState *env, int index)
+static void set_tlb_entry(CPULoongArchState *env, int index, uint8_t csr_ps,
+                          uint64_t csr_vppn, uint64_t lo0, uint64_t lo1)
 {
     LoongArchTLB *tlb = &env->tlb[index];
-    uint64_t lo0, lo1, csr_vppn;
     uint16_t csr_asid;
-    uint8_t csr_ps;
-
-    if (FIELD_EX64(env->CSR_TLBRERA, CSR_TLBRERA, ISTLBR)) {
-        csr_ps = FIELD_EX64(env->CSR_TLBREHI, CSR_TLBREHI, PS);
-        if (is_la64(env)) {
-            csr_vppn = FIELD_EX64(env->CSR_TLBREHI, CSR_TLBREHI_64, VPPN);
-        } else {
-            csr_vppn = FIELD_EX64(env->CSR_TLBREHI, CSR_TLBREHI_32, VPPN);
-        }
-        lo0 = env->CSR_TLBRELO0;
-        lo1 = env->CSR_TLBRELO1;
-    } else {
-        /* Use effective CSR values for virtualization support */
-        csr_ps = FIELD_EX64(get_effective_csr_tlbidx(env), CSR_TLBIDX, PS);
-        if (is_la64(env)) {
-            csr_vppn = FIELD_EX64(get_effective_csr_tlbehi(env), CSR_TLBEHI_64, VPPN);
-        } else {
-            csr_vppn = FIELD_EX64(get_effective_csr_tlbehi(env), CSR_TLBEHI_32, VPPN);
-        }
-        lo0 = get_effective_csr_tlbelo0(env);
-        lo1 = get_effective_csr_tlbelo1(env);
-    }
 
     if (csr_ps == 0) {
         qemu_log_mask(CPU_LOG_MMU, "page size is 0\n");
@@ -309,6 +294,37 @@ static void fill_tlb_entry(CPULoongArchState *env, int index)
     tlb->tlb_entry1 = lo1;
 }
 
+static void fill_tlb_entry(CPULoongArchState *env, int index)
+{
+    uint64_t lo0, lo1, csr_vppn;
+    uint8_t csr_ps;
+
+    if (FIELD_EX64(EFFECTIVE_CSR(env, TLBRERA), CSR_TLBRERA, ISTLBR)) {
+        csr_ps = FIELD_EX64(EFFECTIVE_CSR(env, TLBREHI), CSR_TLBREHI, PS);
+        if (is_la64(env)) {
+            csr_vppn = FIELD_EX64(EFFECTIVE_CSR(env, TLBREHI),
+                                  CSR_TLBREHI_64, VPPN);
+        } else {
+            csr_vppn = FIELD_EX64(EFFECTIVE_CSR(env, TLBREHI),
+                                  CSR_TLBREHI_32, VPPN);
+        }
+        lo0 = EFFECTIVE_CSR(env, TLBRELO0);
+        lo1 = EFFECTIVE_CSR(env, TLBRELO1);
+    } else {
+        /* Use effective CSR values for virtualization support */
+        csr_ps = FIELD_EX64(get_effective_csr_tlbidx(env), CSR_TLBIDX, PS);
+        if (is_la64(env)) {
+            csr_vppn = FIELD_EX64(get_effective_csr_tlbehi(env), CSR_TLBEHI_64, VPPN);
+        } else {
+            csr_vppn = FIELD_EX64(get_effective_csr_tlbehi(env), CSR_TLBEHI_32, VPPN);
+        }
+        lo0 = get_effective_csr_tlbelo0(env);
+        lo1 = get_effective_csr_tlbelo1(env);
+    }
+
+    set_tlb_entry(env, index, csr_ps, csr_vppn, lo0, lo1);
+}
+
 /* Return an random value between low and high */
 static uint32_t get_random_tlb(uint32_t low, uint32_t high)
 {
@@ -323,8 +339,8 @@ void helper_tlbsrch(CPULoongArchState *env)
     int index, match;
     uint64_t search_ehi;
 
-    if (FIELD_EX64(env->CSR_TLBRERA, CSR_TLBRERA, ISTLBR)) {
-        search_ehi = env->CSR_TLBREHI;
+    if (FIELD_EX64(EFFECTIVE_CSR(env, TLBRERA), CSR_TLBRERA, ISTLBR)) {
+        search_ehi = EFFECTIVE_CSR(env, TLBREHI);
     } else {
         /* Use effective CSR for virtualization support */
         search_ehi = get_effective_csr_tlbehi(env);
@@ -366,7 +382,7 @@ void helper_tlbrd(CPULoongArchState *env)
     if (index >= LOONGARCH_STLB) {
         tlb_ps = FIELD_EX64(tlb->tlb_misc, TLB_MISC, PS);
     } else {
-        tlb_ps = FIELD_EX64(env->CSR_STLBPS, CSR_STLBPS, PS);
+        tlb_ps = FIELD_EX64(EFFECTIVE_CSR(env, STLBPS), CSR_STLBPS, PS);
     }
     tlb_e = FIELD_EX64(tlb->tlb_misc, TLB_MISC, E);
 
@@ -406,22 +422,15 @@ void helper_tlbwr(CPULoongArchState *env)
     fill_tlb_entry(env, index);
 }
 
-void helper_tlbfill(CPULoongArchState *env)
+/* Pick the TLB entry that TLBFILL replaces for a page at ENTRYHI */
+static int get_tlb_fill_index(CPULoongArchState *env, uint64_t entryhi,
+                              uint16_t pagesize)
 {
-    uint64_t address, entryhi;
+    uint64_t address;
     int index, set, stlb_idx;
-    uint16_t pagesize, stlb_ps;
+    uint16_t stlb_ps;
 
-    if (FIELD_EX64(env->CSR_TLBRERA, CSR_TLBRERA, ISTLBR)) {
-        entryhi = env->CSR_TLBREHI;
-        pagesize = FIELD_EX64(env->CSR_TLBREHI, CSR_TLBREHI, PS);
-    } else {
-        /* Use effective CSR for virtualization support */
-        entryhi = get_effective_csr_tlbehi(env);
-        pagesize = FIELD_EX64(get_effective_csr_tlbidx(env), CSR_TLBIDX, PS);
-    }
-
-    stlb_ps = FIELD_EX64(env->CSR_STLBPS, CSR_STLBPS, PS);
+    stlb_ps = FIELD_EX64(EFFECTIVE_CSR(env, STLBPS), CSR_STLBPS, PS);
 
     if (pagesize == stlb_ps) {
         /* Only write into STLB bits [47:13] */
@@ -439,6 +448,26 @@ void helper_tlbfill(CPULoongArchState *env)
         index = get_random_tlb(LOONGARCH_STLB, LOONGARCH_TLB_MAX - 1);
     }
 
+    return index;
+}
+
+void helper_tlbfill(CPULoongArchState *env)
+{
+    uint64_t entryhi;
+    uint16_t pagesize;
+    int index;
+
+    if (FIELD_EX64(EFFECTIVE_CSR(env, TLBRERA), CSR_TLBRERA, ISTLBR)) {
+        entryhi = EFFECTIVE_CSR(env, TLBREHI);
+        pagesize = FIELD_EX64(EFFECTIVE_CSR(env, TLBREHI), CSR_TLBREHI, PS);
+    } else {
+        /* Use effective CSR for virtualization support */
+        entryhi = get_effective_csr_tlbehi(env);
+        pagesize = FIELD_EX64(get_effective_csr_tlbidx(env), CSR_TLBIDX, PS);
+    }
+
+    index = get_tlb_fill_index(env, entryhi, pagesize);
+
     /* Always invalidate old entry before filling new one */
     invalidate_tlb_entry(env, index);
     fill_tlb_entry(env, index);
@@ -585,7 +614,7 @@ void helper_invtlb_page_asid(CPULoongArchState *env, target_ulong info,
         if (i >= LOONGARCH_STLB) {
             tlb_ps = FIELD_EX64(tlb->tlb_misc, TLB_MISC, PS);
         } else {
-            tlb_ps = FIELD_EX64(env->CSR_STLBPS, CSR_STLBPS, PS);
+            tlb_ps = FIELD_EX64(EFFECTIVE_CSR(env, STLBPS), CSR_STLBPS, PS);
         }
         tlb_vppn = FIELD_EX64(tlb->tlb_misc, TLB_MISC, VPPN);
         vpn = (addr & TARGET_VIRT_MASK) >> (tlb_ps + 1);
@@ -619,7 +648,7 @@ void helper_invtlb_page_asid_or_g(CPULoongArchState *env,
         if (i >= LOONGARCH_STLB) {
             tlb_ps = FIELD_EX64(tlb->tlb_misc, TLB_MISC, PS);
         } else {
-            tlb_ps = FIELD_EX64(env->CSR_STLBPS, CSR_STLBPS, PS);
+            tlb_ps = FIELD_EX64(EFFECTIVE_CSR(env, STLBPS), CSR_STLBPS, PS);
         }
         tlb_vppn = FIELD_EX64(tlb->tlb_misc, TLB_MISC, VPPN);
         vpn = (addr & TARGET_VIRT_MASK) >> (tlb_ps + 1);
@@ -633,53 +662,20 @@ void helper_invtlb_page_asid_or_g(CPULoongArchState *env,
     tlb_flush(env_cpu(env));
 }
 
-bool loongarch_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
-                            MMUAccessType access_type, int mmu_idx,
-                            bool probe, uintptr_t retaddr)
-{
-    CPULoongArchState *env = cpu_env(cs);
-    hwaddr physical;
-    int prot;
-    int ret;
-
-    /* Data access */
-    ret = get_physical_address(env, &physical, &prot, address,
-                               access_type, mmu_idx);
-
-    if (ret == TLBRET_MATCH) {
-        tlb_set_page(cs, address & TARGET_PAGE_MASK,
-                     physical & TARGET_PAGE_MASK, prot,
-                     mmu_idx, TARGET_PAGE_SIZE);
-        qemu_log_mask(CPU_LOG_MMU,
-                      "%s address=%" VADDR_PRIx " physical " HWADDR_FMT_plx
-                      " prot %d\n", __func__, address, physical, prot);
-        return true;
-    } else {
-        qemu_log_mask(CPU_LOG_MMU,
-                      "%s address=%" VADDR_PRIx " ret %d\n", __func__, address,
-                      ret);
-    }
-    if (probe) {
-        return false;
-    }
-    raise_mmu_exception(env, address, access_type, ret);
-    cpu_loop_exit_restore(cs, retaddr);
-}
-
-target_ulong helper_lddir(CPULoongArchState *env, target_ulong base,
-                          target_ulong level, uint32_t mem_idx)
+/*
+ * One step of the page table walk done by LDDIR: return the directory
+ * entry for BADV at LEVEL of the table at BASE.  Huge page entries are
+ * passed through, tagged with the level they were found at.
+ */
+static target_ulong loongarch_walk_dir(CPULoongArchState *env,
+                                       target_ulong base, target_ulong level,
+                                       target_ulong badvaddr)
 {
     CPUState *cs = env_cpu(env);
-    target_ulong badvaddr, index, phys, ret;
+    target_ulong index, phys;
     int shift;
     uint64_t dir_base, dir_width;
 
-    if (unlikely((level == 0) || (level > 4))) {
-        qemu_log_mask(LOG_GUEST_ERROR,
-                      "Attepted LDDIR with level %"PRId64"\n", level);
-        return base;
-    }
-
     if (FIELD_EX64(base, TLBENTRY, HUGE)) {
         if (unlikely(level == 4)) {
             qemu_log_mask(LOG_GUEST_ERROR,
@@ -693,28 +689,33 @@ target_ulong helper_lddir(CPULoongArchState *env, target_ulong base,
         }
     }
 
-    badvaddr = env->CSR_TLBRBADV;
     base = base & TARGET_PHYS_MASK;
 
     /* 0:64bit, 1:128bit, 2:192bit, 3:256bit */
-    shift = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, PTEWIDTH);
+    shift = FIELD_EX64(EFFECTIVE_CSR(env, PWCL), CSR_PWCL, PTEWIDTH);
     shift = (shift + 1) * 3;
 
     get_dir_base_width(env, &dir_base, &dir_width, level);
     index = (badvaddr >> dir_base) & ((1 << dir_width) - 1);
     phys = base | index << shift;
-    ret = ldq_phys(cs->as, phys) & TARGET_PHYS_MASK;
-    return ret;
+    return ldq_phys(cs->as, phys) & TARGET_PHYS_MASK;
 }
 
-void helper_ldpte(CPULoongArchState *env, target_ulong base, target_ulong odd,
-                  uint32_t mem_idx)
+/*
+ * The last step of the walk, done by LDPTE: return the even or odd TLB
+ * entry for BADV from the page table or huge page entry at BASE, and
+ * the page size in *PS.
+ */
+static target_ulong loongarch_walk_pte(CPULoongArchState *env,
+                                       target_ulong base, target_ulong odd,
+                                       target_ulong badv, uint64_t *ps)
 {
     CPUState *cs = env_cpu(env);
-    target_ulong phys, tmp0, ptindex, ptoffset0, ptoffset1, ps, badv;
+    target_ulong phys, tmp0, ptindex, ptoffset0, ptoffset1;
     int shift;
-    uint64_t ptbase = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, PTBASE);
-    uint64_t ptwidth = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, PTWIDTH);
+    uint64_t pwcl = EFFECTIVE_CSR(env, PWCL);
+    uint64_t ptbase = FIELD_EX64(pwcl, CSR_PWCL, PTBASE);
+    uint64_t ptwidth = FIELD_EX64(pwcl, CSR_PWCL, PTWIDTH);
     uint64_t dir_base, dir_width;
 
     /*
@@ -742,7 +743,7 @@ void helper_ldpte(CPULoongArchState *env, target_ulong base, target_ulong odd,
             base = FIELD_DP64(base, TLBENTRY, G, 1);
         }
 
-        ps = dir_base + dir_width - 1;
+        *ps = dir_base + dir_width - 1;
         /*
          * Huge pages are evenly split into parity pages
          * when loaded into the tlb,
@@ -750,13 +751,12 @@ void helper_ldpte(CPULoongArchState *env, target_ulong base, target_ulong odd,
          */
         tmp0 = base;
         if (odd) {
-            tmp0 += MAKE_64BIT_MASK(ps, 1);
+            tmp0 += MAKE_64BIT_MASK(*ps, 1);
         }
     } else {
         /* 0:64bit, 1:128bit, 2:192bit, 3:256bit */
-        shift = FIELD_EX64(env->CSR_PWCL, CSR_PWCL, PTEWIDTH);
+        shift = FIELD_EX64(EFFECTIVE_CSR(env, PWCL), CSR_PWCL, PTEWIDTH);
         shift = (shift + 1) * 3;
-        badv = env->CSR_TLBRBADV;
 
         ptindex = (badv >> ptbase) & ((1 << ptwidth) - 1);
         ptindex = ptindex & ~0x1;   /* clear bit 0 */
@@ -765,15 +765,118 @@ void helper_ldpte(CPULoongArchState *env, target_ulong base, target_ulong odd,
 
         phys = base | (odd ? ptoffset1 : ptoffset0);
         tmp0 = ldq_phys(cs->as, phys) & TARGET_PHYS_MASK;
-        ps = ptbase;
+        *ps = ptbase;
+    }
+
+    return tmp0;
+}
+
+/*
+ * Hardware page table walker.  With CPUCFG2.HPTW advertised and enabled
+ * through PWCH.HPTW_EN, a TLB refill is handled here by doing the same
+ * walk the guest's TLBR handler would do with LDDIR/LDPTE and installing
+ * the result as TLBFILL would, without taking the refill exception.
+ * Invalid PTEs are installed as well, so that the retried lookup raises
+ * the same page invalid exception the software refill path would.
+ */
+static bool loongarch_hptw(CPULoongArchState *env, vaddr address)
+{
+    uint64_t dir_base, dir_width, ps, vppn;
+    target_ulong base, lo0, lo1;
+    int level, index;
+
+    if (!FIELD_EX32(env->cpucfg[2], CPUCFG2, HPTW) ||
+        !FIELD_EX64(env->CSR_PWCH, CSR_PWCH, HPTW_EN) ||
+        is_guest_mode(env)) {
+        return false;
+    }
+
+    /* Same selection as reading CSR.PGD in the refill handler */
+    base = extract64(address, 63, 1) ? env->CSR_PGDH : env->CSR_PGDL;
+    for (level = 4; level > 0; level--) {
+        get_dir_base_width(env, &dir_base, &dir_width, level);
+        if (dir_width) {
+            base = loongarch_walk_dir(env, base, level, address);
+        }
+    }
+    lo0 = loongarch_walk_pte(env, base, 0, address, &ps);
+    lo1 = loongarch_walk_pte(env, base, 1, address, &ps);
+
+    if (is_la64(env)) {
+        vppn = extract64(address, 13, 35);
+    } else {
+        vppn = extract64(address, 13, 19);
+    }
+
+    index = get_tlb_fill_index(env, address, ps);
+    invalidate_tlb_entry(env, index);
+    set_tlb_entry(env, index, ps, vppn, lo0, lo1);
+    return true;
+}
+
+bool loongarch_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
+                            MMUAccessType access_type, int mmu_idx,
+                            bool probe, uintptr_t retaddr)
+{
+    CPULoongArchState *env = cpu_env(cs);
+    hwaddr physical;
+    int prot;
+    int ret;
+
+    /* Data access */
+    ret = get_physical_address(env, &physical, &prot, address,
+                               access_type, mmu_idx);
+    if (ret == TLBRET_NOMATCH && loongarch_hptw(env, address)) {
+        ret = get_physical_address(env, &physical, &prot, address,
+                                   access_type, mmu_idx);
+    }
+
+    if (ret == TLBRET_MATCH) {
+        tlb_set_page(cs, address & TARGET_PAGE_MASK,
+                     physical & TARGET_PAGE_MASK, prot,
+                     mmu_idx, TARGET_PAGE_SIZE);
+        qemu_log_mask(CPU_LOG_MMU,
+                      "%s address=%" VADDR_PRIx " physical " HWADDR_FMT_plx
+                      " prot %d\n", __func__, address, physical, prot);
+        return true;
+    } else {
+        qemu_log_mask(CPU_LOG_MMU,
+                      "%s address=%" VADDR_PRIx " ret %d\n", __func__, address,
+                      ret);
+    }
+    if (probe) {
+        return false;
+    }
+    raise_mmu_exception(env, address, access_type, ret);
+    cpu_loop_exit_restore(cs, retaddr);
+}
+
+target_ulong helper_lddir(CPULoongArchState *env, target_ulong base,
+                          target_ulong level, uint32_t mem_idx)
+{
+    if (unlikely((level == 0) || (level > 4))) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "Attepted LDDIR with level %"PRId64"\n", level);
+        return base;
     }
 
+    return loongarch_walk_dir(env, base, level, EFFECTIVE_CSR(env, TLBRBADV));
+}
+
+void helper_ldpte(CPULoongArchState *env, target_ulong base, target_ulong odd,
+                  uint32_t mem_idx)
+{
+    uint64_t ps;
+    target_ulong pte;
+
+    pte = loongarch_walk_pte(env, base, odd, EFFECTIVE_CSR(env, TLBRBADV), &ps);
     if (odd) {
-        env->CSR_TLBRELO1 = tmp0;
+        EFFECTIVE_CSR(env, TLBRELO1) = pte;
     } else {
-        env->CSR_TLBRELO0 = tmp0;
+        EFFECTIVE_CSR(env, TLBRELO0) = pte;
     }
-    env->CSR_TLBREHI = FIELD_DP64(env->CSR_TLBREHI, CSR_TLBREHI, PS, ps);
+    EFFECTIVE_CSR(env, TLBREHI) = FIELD_DP64(EFFECTIVE_CSR(env, TLBREHI),
+                                             CSR_TLBREHI, PS, ps);
 }
 
 /* Guest-aware TLB search function */
@@ -788,7 +891,7 @@ int loongarch_tlb_search_guest(CPULoongArchState *env, target_ulong vaddr, int *
 
     /* Use effective CSR for virtualization support */
     csr_asid = FIELD_EX64(get_effective_csr_asid(env), CSR_ASID, ASID);
-    stlb_ps = FIELD_EX64(env->CSR_STLBPS, CSR_STLBPS, PS);
+    stlb_ps = FIELD_EX64(EFFECTIVE_CSR(env, STLBPS), CSR_STLBPS, PS);
     vpn = (vaddr & TARGET_VIRT_MASK) >> (stlb_ps + 1);
     stlb_idx = vpn & 0xff; /* VA[25:15] <==> TLBIDX.index for 16KiB Page */
     compare_shift = stlb_ps + 1 - R_TLB_MISC_VPPN_SHIFT;
@@ -142,6 +142,7 @@ static void loongarch_tr_init_disas_context(DisasContextBase *dcbase,
 
     ctx->la64 = is_la64(env);
     ctx->va32 = (ctx->base.tb->flags & HW_FLAGS_VA32) != 0;
+    ctx->guest = (ctx->base.tb->flags & HW_FLAGS_GUEST) != 0;
 
     ctx->zero = tcg_constant_tl(0);
 
@@ -48,6 +48,7 @@ typedef struct DisasContext {
     TCGv zero;
     bool la64; /* LoongArch64 mode */
     bool va32; /* 32-bit virtual address */
+    bool guest; /* LVZ guest mode */
     uint32_t cpucfg1;
     uint32_t cpucfg2;
 } DisasContext;
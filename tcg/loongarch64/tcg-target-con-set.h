@@ -38,4 +38,5 @@ C_O1_I2(w, w, wM)
 C_O1_I2(w, w, wA)
 C_O1_I3(w, w, w, w)
 C_O1_I4(r, rZ, rJ, rZ, rZ)
+C_O1_I4(w, w, wM, w, w)
 C_N2_I1(r, r, r)
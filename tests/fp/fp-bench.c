@@ -14,6 +14,7 @@
 #include <math.h>
 #include <fenv.h>
 #include "qemu/timer.h"
+#include "qemu/bitops.h"
 #include "qemu/int128.h"
 #include "fpu/softfloat.h"
 
@@ -34,6 +35,8 @@ enum op {
     OP_FMA,
     OP_SQRT,
     OP_CMP,
+    OP_MAX,
+    OP_TOINT,
     OP_MAX_NR,
 };
 
@@ -45,6 +48,8 @@ static const char * const op_names[] = {
     [OP_FMA] = "mulAdd",
     [OP_SQRT] = "sqrt",
     [OP_CMP] = "cmp",
+    [OP_MAX] = "max",
+    [OP_TOINT] = "toint",
     [OP_MAX_NR] = NULL,
 };
 
@@ -225,6 +230,40 @@ static void fill_random(union fp *ops, int n_ops, enum precision prec,
     }
 }
 
+/*
+ * Shrink the exponent of a random operand so that the value fits in an
+ * int64_t, otherwise conversions would only ever exercise the overflow path.
+ */
+static void fill_int_range(union fp *op, enum precision prec)
+{
+    switch (prec) {
+    case PREC_SINGLE:
+    case PREC_FLOAT32:
+    {
+        uint32_t r = float32_val(op->f32);
+
+        op->f32 = make_float32(deposit32(r, 23, 8, 127 + extract32(r, 23, 5)));
+        break;
+    }
+    case PREC_DOUBLE:
+    case PREC_FLOAT64:
+    {
+        uint64_t r = float64_val(op->f64);
+
+        op->f64 = make_float64(deposit64(r, 52, 11,
+                                         1023 + extract64(r, 52, 5)));
+        break;
+    }
+    case PREC_QUAD:
+    case PREC_FLOAT128:
+        op->f128.high = deposit64(op->f128.high, 48, 15,
+                                  16383 + extract64(op->f128.high, 48, 5));
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
 /*
  * The main benchmark function. Instead of (ab)using macros, we rely
  * on the compiler to unfold this at compile-time.
@@ -242,6 +281,9 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
         switch (prec) {
         case PREC_SINGLE:
             fill_random(ops, n_ops, prec, no_neg);
+            if (op == OP_TOINT) {
+                fill_int_range(&ops[0], prec);
+            }
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float a = ops[0].f;
@@ -270,6 +312,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = isgreater(a, b);
                     break;
+                case OP_MAX:
+                    res.f = fmaxf(a, b);
+                    break;
+                case OP_TOINT:
+                    res.u64 = llrintf(a);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -277,6 +325,9 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
             break;
         case PREC_DOUBLE:
             fill_random(ops, n_ops, prec, no_neg);
+            if (op == OP_TOINT) {
+                fill_int_range(&ops[0], prec);
+            }
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 double a = ops[0].d;
@@ -305,6 +356,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = isgreater(a, b);
                     break;
+                case OP_MAX:
+                    res.d = fmax(a, b);
+                    break;
+                case OP_TOINT:
+                    res.u64 = llrint(a);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -312,6 +369,9 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
             break;
         case PREC_FLOAT32:
             fill_random(ops, n_ops, prec, no_neg);
+            if (op == OP_TOINT) {
+                fill_int_range(&ops[0], prec);
+            }
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float32 a = ops[0].f32;
@@ -340,6 +400,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float32_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_MAX:
+                    res.f32 = float32_maxnum(a, b, &soft_status);
+                    break;
+                case OP_TOINT:
+                    res.u64 = float32_to_int64(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -347,6 +413,9 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
             break;
         case PREC_FLOAT64:
             fill_random(ops, n_ops, prec, no_neg);
+            if (op == OP_TOINT) {
+                fill_int_range(&ops[0], prec);
+            }
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float64 a = ops[0].f64;
@@ -375,6 +444,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float64_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_MAX:
+                    res.f64 = float64_maxnum(a, b, &soft_status);
+                    break;
+                case OP_TOINT:
+                    res.u64 = float64_to_int64(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -382,6 +457,9 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
             break;
         case PREC_FLOAT128:
             fill_random(ops, n_ops, prec, no_neg);
+            if (op == OP_TOINT) {
+                fill_int_range(&ops[0], prec);
+            }
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float128 a = ops[0].f128;
@@ -410,6 +488,12 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float128_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_MAX:
+                    res.f128 = float128_maxnum(a, b, &soft_status);
+                    break;
+                case OP_TOINT:
+                    res.u64 = float128_to_int64(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -448,6 +532,8 @@ GEN_BENCH_ALL_TYPES(mul, OP_MUL, 2)
 GEN_BENCH_ALL_TYPES(div, OP_DIV, 2)
 GEN_BENCH_ALL_TYPES(fma, OP_FMA, 3)
 GEN_BENCH_ALL_TYPES(cmp, OP_CMP, 2)
+GEN_BENCH_ALL_TYPES(max, OP_MAX, 2)
+GEN_BENCH_ALL_TYPES(toint, OP_TOINT, 1)
 #undef GEN_BENCH_ALL_TYPES
 
 #define GEN_BENCH_ALL_TYPES_NO_NEG(name, op, n)                         \
@@ -480,6 +566,8 @@ static const bench_func_t bench_funcs[OP_MAX_NR][PREC_MAX_NR] = {
     GEN_BENCH_FUNCS(fma, OP_FMA),
     GEN_BENCH_FUNCS(sqrt, OP_SQRT),
     GEN_BENCH_FUNCS(cmp, OP_CMP),
+    GEN_BENCH_FUNCS(max, OP_MAX),
+    GEN_BENCH_FUNCS(toint, OP_TOINT),
 };
 
 #undef GEN_BENCH_FUNCS
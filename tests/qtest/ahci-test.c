@@ -1518,6 +1518,78 @@ static void test_ncq_simple(void)
     ahci_shutdown(ahci);
 }
 
+/**
+ * Issue several NCQ reads at once and check that their completions are
+ * reported together, by a single Set Device Bits FIS.
+ * The null-co driver completes all the reads before the bottom half that
+ * writes the FIS gets to run, so the coalescing is deterministic.
+ */
+static void test_ncq_coalesced(void)
+{
+    AHCIQState *ahci;
+    AHCICommand *cmds[4];
+    uint64_t ptrs[4];
+    uint32_t slots = 0;
+    size_t bufsize = 4096;
+    unsigned char *tx = g_malloc(bufsize);
+    unsigned char *rx = g_malloc(bufsize);
+    unsigned char *zero = g_malloc0(bufsize);
+    uint8_t sdb[8];
+    uint8_t port;
+    int i;
+
+    ahci = ahci_boot_and_enable("-drive if=none,id=drive0,driver=null-co,"
+                                "read-zeroes=on "
+                                "-M q35 "
+                                "-device ide-hd,drive=drive0 ");
+    port = ahci_port_select(ahci);
+    ahci_port_clear(ahci, port);
+    generate_pattern(tx, bufsize, AHCI_SECTOR_SIZE);
+
+    /* The reads overwrite a pattern with zeroes */
+    for (i = 0; i < ARRAY_SIZE(cmds); i++) {
+        ptrs[i] = ahci_alloc(ahci, bufsize);
+        g_assert(ptrs[i]);
+        qtest_memwrite(ahci->parent->qts, ptrs[i], tx, bufsize);
+
+        cmds[i] = ahci_command_create(READ_FPDMA_QUEUED);
+        ahci_command_adjust(cmds[i], i * bufsize, ptrs[i], bufsize, 0);
+        ahci_command_commit(ahci, cmds[i], port);
+        slots |= 1 << ahci_command_slot(cmds[i]);
+    }
+
+    /* Queue all of them with a single write, like a guest driver would */
+    ahci_px_wreg(ahci, port, AHCI_PX_SACT, slots);
+    ahci_px_wreg(ahci, port, AHCI_PX_CI, slots);
+
+    for (i = 0; i < ARRAY_SIZE(cmds); i++) {
+        ahci_command_wait(ahci, cmds[i]);
+        ahci_port_check_nonbusy(ahci, cmds[i]);
+        ahci_port_check_error(ahci, cmds[i]);
+        ahci_port_check_cmd_sanity(ahci, cmds[i]);
+    }
+    /* SDBS is the only interrupt raised */
+    ahci_port_check_interrupts(ahci, cmds[0]);
+
+    /* The last SDB FIS completes every command */
+    qtest_memread(ahci->parent->qts, ahci->port[port].fb + 0x58,
+                  sdb, sizeof(sdb));
+    g_assert_cmphex(sdb[0], ==, SDB_FIS);
+    g_assert_cmphex(ldl_le_p(&sdb[4]), ==, slots);
+
+    for (i = 0; i < ARRAY_SIZE(cmds); i++) {
+        qtest_memread(ahci->parent->qts, ptrs[i], rx, bufsize);
+        g_assert_cmphex(memcmp(zero, rx, bufsize), ==, 0);
+        ahci_free(ahci, ptrs[i]);
+        ahci_command_free(cmds[i]);
+    }
+
+    ahci_shutdown(ahci);
+    g_free(zero);
+    g_free(rx);
+    g_free(tx);
+}
+
 static int prepare_iso(size_t size, unsigned char **buf, char **name)
 {
     g_autofree char *cdrom_path = NULL;
@@ -2032,6 +2104,7 @@ int main(int argc, char **argv)
     qtest_add_func("/ahci/reset/pending_callback", test_reset_pending_callback);
 
     qtest_add_func("/ahci/io/ncq/simple", test_ncq_simple);
+    qtest_add_func("/ahci/io/ncq/coalesced", test_ncq_coalesced);
     qtest_add_func("/ahci/migrate/ncq/simple", test_migrate_ncq);
     qtest_add_func("/ahci/io/ncq/retry", test_halted_ncq);
     qtest_add_func("/ahci/migrate/ncq/halted", test_migrate_halted_ncq);
@@ -0,0 +1,231 @@
+/*
+ * QTest testcase for memory-backend-pool
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "qemu/memfd.h"
+#include "libqtest.h"
+#include "qapi/error.h"
+#include "qapi/qmp/qdict.h"
+
+/* See docs/interop/memory-backend-pool.rst */
+#define POOL_MAGIC      0x4c4f4f50
+#define POOL_VERSION    1
+
+#define BACKEND_SIZE    (4 * 1024 * 1024)
+
+typedef struct PoolRequest {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    uint64_t page_size;
+} PoolRequest;
+
+typedef struct PoolReply {
+    uint32_t magic;
+    int32_t status;
+    uint64_t size;
+} PoolReply;
+
+/* A stub pool daemon serving a single connection */
+typedef struct TestPool {
+    char *dir;
+    char *path;
+    int listen_fd;
+    GThread *thread;
+
+    /* Reply status to send */
+    int32_t status;
+    /* Size of the passed memfd, the reply always claims the requested size */
+    uint64_t fd_size;
+
+    /* Set by the daemon thread */
+    PoolRequest req;
+    bool closed;
+} TestPool;
+
+static void test_pool_send_reply(int fd, PoolReply *reply, int memfd)
+{
+    struct iovec iov = { .iov_base = reply, .iov_len = sizeof(*reply) };
+    char control[CMSG_SPACE(sizeof(int))] = { 0 };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+    struct cmsghdr *cmsg;
+
+    if (memfd >= 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+    }
+    g_assert_cmpint(sendmsg(fd, &msg, 0), ==, sizeof(*reply));
+}
+
+static gpointer test_pool_thread(gpointer opaque)
+{
+    TestPool *pool = opaque;
+    PoolReply reply = { .magic = POOL_MAGIC, .status = pool->status };
+    int memfd = -1;
+    char c;
+    int fd;
+
+    fd = accept(pool->listen_fd, NULL, NULL);
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_cmpint(read(fd, &pool->req, sizeof(pool->req)), ==,
+                    sizeof(pool->req));
+
+    if (!reply.status) {
+        memfd = qemu_memfd_create("test-pool", pool->fd_size, false, 0, 0,
+                                  &error_abort);
+        reply.size = pool->req.size;
+    }
+    test_pool_send_reply(fd, &reply, memfd);
+    if (memfd >= 0) {
+        close(memfd);
+    }
+
+    /* QEMU owns the memory until it closes the connection */
+    g_assert_cmpint(read(fd, &c, 1), ==, 0);
+    pool->closed = true;
+    close(fd);
+    return NULL;
+}
+
+static void test_pool_start(TestPool *pool, int32_t status, uint64_t fd_size)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    pool->dir = g_dir_make_tmp("hostmem-pool-test-XXXXXX", NULL);
+    g_assert_nonnull(pool->dir);
+    pool->path = g_build_filename(pool->dir, "pool.sock", NULL);
+    g_assert_cmpint(strlen(pool->path), <, sizeof(addr.sun_path));
+    strcpy(addr.sun_path, pool->path);
+
+    pool->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    g_assert_cmpint(pool->listen_fd, >=, 0);
+    g_assert_cmpint(bind(pool->listen_fd, (struct sockaddr *)&addr,
+                         sizeof(addr)), ==, 0);
+    g_assert_cmpint(listen(pool->listen_fd, 1), ==, 0);
+
+    pool->status = status;
+    pool->fd_size = fd_size;
+    pool->thread = g_thread_new("test-pool", test_pool_thread, pool);
+}
+
+static void test_pool_stop(TestPool *pool)
+{
+    g_thread_join(pool->thread);
+    close(pool->listen_fd);
+    unlink(pool->path);
+    rmdir(pool->dir);
+    g_free(pool->path);
+    g_free(pool->dir);
+}
+
+static QDict *test_pool_add_backend(QTestState *qts, TestPool *pool,
+                                    bool fallback)
+{
+    return qtest_qmp(qts, "{'execute': 'object-add', 'arguments':"
+                     " {'qom-type': 'memory-backend-pool', 'id': 'mem0',"
+                     " 'size': %d, 'path': %s, 'fallback': %i } }",
+                     BACKEND_SIZE, pool->path, fallback);
+}
+
+/* The memory is taken from the pool and handed back on exit */
+static void test_pool_alloc(void)
+{
+    TestPool pool = { 0 };
+    QTestState *qts;
+    QDict *resp;
+
+    test_pool_start(&pool, 0, BACKEND_SIZE);
+    qts = qtest_init("-machine none");
+
+    resp = test_pool_add_backend(qts, &pool, false);
+    g_assert(qdict_haskey(resp, "return"));
+    qobject_unref(resp);
+
+    g_assert_cmphex(pool.req.magic, ==, POOL_MAGIC);
+    g_assert_cmpuint(pool.req.version, ==, POOL_VERSION);
+    g_assert_cmpuint(pool.req.size, ==, BACKEND_SIZE);
+    g_assert_cmpuint(pool.req.page_size, ==, 0);
+
+    qtest_quit(qts);
+    test_pool_stop(&pool);
+    g_assert_true(pool.closed);
+}
+
+/* A memfd smaller than the backend is rejected, whatever the reply says */
+static void test_pool_short_fd(void)
+{
+    TestPool pool = { 0 };
+    QTestState *qts;
+
+    test_pool_start(&pool, 0, BACKEND_SIZE / 2);
+    qts = qtest_init("-machine none");
+
+    qmp_expect_error_and_unref(test_pool_add_backend(qts, &pool, false),
+                               "GenericError");
+
+    qtest_quit(qts);
+    test_pool_stop(&pool);
+    g_assert_true(pool.closed);
+}
+
+static void test_pool_refused(void)
+{
+    TestPool pool = { 0 };
+    QTestState *qts;
+
+    test_pool_start(&pool, -ENOMEM, 0);
+    qts = qtest_init("-machine none");
+
+    qmp_expect_error_and_unref(test_pool_add_backend(qts, &pool, false),
+                               "GenericError");
+
+    qtest_quit(qts);
+    test_pool_stop(&pool);
+}
+
+static void test_pool_fallback(void)
+{
+    TestPool pool = { 0 };
+    QTestState *qts;
+    QDict *resp;
+
+    test_pool_start(&pool, -ENOMEM, 0);
+    qts = qtest_init("-machine none");
+
+    resp = test_pool_add_backend(qts, &pool, true);
+    g_assert(qdict_haskey(resp, "return"));
+    qobject_unref(resp);
+
+    qtest_quit(qts);
+    test_pool_stop(&pool);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    if (!qtest_has_machine("none")) {
+        return g_test_run();
+    }
+
+    qtest_add_func("hostmem-pool/alloc", test_pool_alloc);
+    qtest_add_func("hostmem-pool/short-fd", test_pool_short_fd);
+    qtest_add_func("hostmem-pool/refused", test_pool_refused);
+    qtest_add_func("hostmem-pool/fallback", test_pool_fallback);
+
+    return g_test_run();
+}
@@ -2301,6 +2301,72 @@ static void test_precopy_file_mapped_ram(void)
     test_file_common(&args, true);
 }
 
+static void *migrate_lazy_restore_start(QTestState *from, QTestState *to)
+{
+    migrate_mapped_ram_start(from, to);
+    migrate_set_capability(to, "x-lazy-restore", true);
+
+    return NULL;
+}
+
+static void test_precopy_file_mapped_ram_lazy(void)
+{
+    g_autofree char *uri = g_strdup_printf("file:%s/%s", tmpfs,
+                                           FILE_TEST_FILENAME);
+    MigrateCommon args = {
+        .connect_uri = uri,
+        .listen_uri = "defer",
+        .start_hook = migrate_lazy_restore_start,
+    };
+
+    test_file_common(&args, true);
+}
+
+/*
+ * The pages are only read from the file once the destination runs. If that
+ * fails, the vCPUs must not hang on the missing pages: the VM stops with an
+ * internal error instead.
+ */
+static void test_precopy_file_mapped_ram_lazy_error(void)
+{
+    g_autofree char *uri = g_strdup_printf("file:%s/%s", tmpfs,
+                                           FILE_TEST_FILENAME);
+    g_autofree char *path = g_strdup_printf("%s/%s", tmpfs,
+                                            FILE_TEST_FILENAME);
+    MigrateStart args = {};
+    QTestState *from, *to;
+    QDict *rsp;
+
+    if (test_migrate_start(&from, &to, "defer", &args)) {
+        return;
+    }
+
+    migrate_lazy_restore_start(from, to);
+    migrate_ensure_converge(from);
+    wait_for_serial("src_serial");
+
+    qtest_qmp_assert_success(from, "{ 'execute' : 'stop'}");
+    wait_for_stop(from, &src_state);
+
+    migrate_qmp(from, to, uri, NULL, "{}");
+    wait_for_migration_complete(from);
+    migrate_incoming_qmp(to, uri, "{}");
+    wait_for_migration_complete(to);
+
+    /* Pull the pages from under the destination */
+    g_assert_cmpint(truncate(path, 0), ==, 0);
+
+    qtest_qmp_assert_success(to, "{ 'execute' : 'cont'}");
+    wait_for_resume(to, &dst_state);
+    qtest_qmp_eventwait(to, "STOP");
+
+    rsp = qtest_qmp_assert_success_ref(to, "{ 'execute': 'query-status' }");
+    g_assert_cmpstr(qdict_get_str(rsp, "status"), ==, "internal-error");
+    qobject_unref(rsp);
+
+    test_migrate_end(from, to, false);
+}
+
 static void *migrate_multifd_mapped_ram_start(QTestState *from, QTestState *to)
 {
     migrate_mapped_ram_start(from, to);
@@ -3876,6 +3942,13 @@ int main(int argc, char **argv)
     migration_test_add("/migration/precopy/file/mapped-ram/live",
                        test_precopy_file_mapped_ram_live);
 
+    if (has_uffd) {
+        migration_test_add("/migration/precopy/file/mapped-ram/lazy",
+                           test_precopy_file_mapped_ram_lazy);
+        migration_test_add("/migration/precopy/file/mapped-ram/lazy/error",
+                           test_precopy_file_mapped_ram_lazy_error);
+    }
+
     migration_test_add("/migration/multifd/file/mapped-ram",
                        test_multifd_file_mapped_ram);
     migration_test_add("/migration/multifd/file/mapped-ram/live",
@@ -10,6 +10,8 @@
 
 #include "qemu/osdep.h"
 #include "libqtest-single.h"
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qlist.h"
 #include "qemu/module.h"
 #include "scsi/constants.h"
 #include "libqos/libqos-pc.h"
@@ -200,6 +202,44 @@ static void test_unaligned_write_same(void *obj, void *data,
     qvirtio_scsi_pci_free(vs);
 }
 
+/*
+ * Test WRITE SAME with werror=ignore and an error in the middle: the command
+ * succeeds and the following chunks are written anyway
+ */
+static void test_write_same_ignore_error(void *obj, void *data,
+                                         QGuestAllocator *t_alloc)
+{
+    QVirtioSCSI *scsi = obj;
+    QVirtioSCSIQueues *vs;
+    uint8_t buf[512];
+    /* 16 MiB, more chunks than are submitted at once */
+    const uint8_t write_same_cdb[VIRTIO_SCSI_CDB_SIZE] = {
+        0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00
+    };
+    struct virtio_scsi_cmd_resp resp;
+    QDict *rsp, *stats;
+    QList *devices;
+
+    alloc = t_alloc;
+    vs = qvirtio_scsi_init(scsi->vdev);
+
+    memset(buf, 0x5a, sizeof(buf));
+    virtio_scsi_do_command(vs, write_same_cdb, NULL, 0, buf, sizeof(buf),
+                           &resp);
+    g_assert_cmphex(resp.response, ==, 0);
+    g_assert_cmphex(resp.status, ==, GOOD);
+
+    rsp = qmp("{'execute': 'query-blockstats'}");
+    devices = qdict_get_qlist(rsp, "return");
+    stats = qdict_get_qdict(qobject_to(QDict, qlist_peek(devices)), "stats");
+    g_assert_cmpint(qdict_get_int(stats, "wr_bytes"), ==, 16 * 1024 * 1024);
+    g_assert_cmpint(qdict_get_int(stats, "wr_operations"), ==, 32);
+    g_assert_cmpint(qdict_get_int(stats, "failed_wr_operations"), ==, 0);
+    qobject_unref(rsp);
+
+    qvirtio_scsi_pci_free(vs);
+}
+
 /* Test UNMAP with a large LBA, issue #345 */
 static void test_unmap_large_lba(void *obj, void *data,
                                       QGuestAllocator *t_alloc)
@@ -329,6 +369,17 @@ static void *virtio_scsi_setup(GString *cmd_line, void *arg)
     return arg;
 }
 
+static void *virtio_scsi_setup_werror_ignore(GString *cmd_line, void *arg)
+{
+    /* Fail the write of the chunk at 4 MiB */
+    g_string_append(cmd_line,
+                    " -blockdev driver=blkdebug,node-name=dr1,"
+                    "inject-error.0.event=pwritev,inject-error.0.sector=8192,"
+                    "image.driver=null-co "
+                    "-device scsi-hd,drive=dr1,lun=0,scsi-id=1,werror=ignore");
+    return arg;
+}
+
 static void *virtio_scsi_setup_4k(GString *cmd_line, void *arg)
 {
     g_string_append(cmd_line,
@@ -370,6 +421,10 @@ static void register_virtio_scsi_test(void)
     qos_add_test("unaligned-write-same", "virtio-scsi",
                  test_unaligned_write_same, &opts);
 
+    opts.before = virtio_scsi_setup_werror_ignore;
+    qos_add_test("write-same-ignore-error", "virtio-scsi",
+                 test_write_same_ignore_error, &opts);
+
     opts.before = virtio_scsi_setup_4k;
     qos_add_test("large-lba-unmap", "virtio-scsi",
                  test_unmap_large_lba, &opts);
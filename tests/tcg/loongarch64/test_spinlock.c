@@ -0,0 +1,92 @@
+/*
+ * Contended spinlock built from LL/SC, AM* atomics and DBAR hints.
+ *
+ * Several threads hammer on a single lock; the protected counter must
+ * end up exact.  The run time of this test under MTTCG is a useful
+ * measure of the cost of guest atomics.
+ */
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NR_THREADS  8
+#define NR_LOOPS    100000
+
+static int32_t lock;
+static int64_t counter;
+static int64_t am_counter;
+
+static void spin_lock(int32_t *l)
+{
+    int32_t tmp;
+
+    asm volatile("1: ll.w   %0, %1\n\t"
+                 "   bnez   %0, 1b\n\t"
+                 "   ori    %0, $r0, 1\n\t"
+                 "   sc.w   %0, %1\n\t"
+                 "   beqz   %0, 1b\n\t"
+                 "   dbar   0x14\n\t"      /* load acquire */
+                 : "=&r"(tmp), "+ZC"(*l)
+                 :
+                 : "memory");
+}
+
+static void spin_unlock(int32_t *l)
+{
+    asm volatile("dbar   0x12\n\t"         /* store release */
+                 "st.w   $r0, %0\n\t"
+                 : "=m"(*l)
+                 :
+                 : "memory");
+}
+
+static void am_add(int64_t *p, int64_t v)
+{
+    int64_t old;
+
+    asm volatile("amadd_db.d %0, %2, %1\n\t"
+                 : "=&r"(old), "+ZB"(*p)
+                 : "r"(v)
+                 : "memory");
+}
+
+static void *thread_func(void *arg)
+{
+    int i;
+
+    for (i = 0; i < NR_LOOPS; i++) {
+        spin_lock(&lock);
+        counter++;
+        spin_unlock(&lock);
+        am_add(&am_counter, 1);
+    }
+    return NULL;
+}
+
+int main()
+{
+    pthread_t threads[NR_THREADS];
+    int i, ret;
+
+    for (i = 0; i < NR_THREADS; i++) {
+        ret = pthread_create(&threads[i], NULL, thread_func, NULL);
+        if (ret) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(ret));
+            return 1;
+        }
+    }
+    for (i = 0; i < NR_THREADS; i++) {
+        ret = pthread_join(threads[i], NULL);
+        if (ret) {
+            fprintf(stderr, "pthread_join: %s\n", strerror(ret));
+            return 1;
+        }
+    }
+
+    assert(lock == 0);
+    assert(counter == (int64_t)NR_THREADS * NR_LOOPS);
+    assert(am_counter == (int64_t)NR_THREADS * NR_LOOPS);
+    return 0;
+}
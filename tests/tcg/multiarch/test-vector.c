@@ -0,0 +1,200 @@
+/*
+ * Vector shifts, rotates, comparisons and selects
+ *
+ * Written with the generic vector extensions of the compiler, which the
+ * guests with SIMD units translate to their vector instructions and QEMU
+ * to gvec operations: shifts and rotates by immediate and by vector,
+ * comparisons including "test bits" (TSTNE), and selects, e.g. the
+ * cmpsel used for the AArch64 USHL/SSHL.  The results are checked against
+ * a scalar computation, so that a wrong inline expansion in a TCG backend
+ * shows up regardless of the guest.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VEC_BYTES 16
+#define NB_ROUNDS 64
+
+static int errors;
+
+static uint64_t seed = 0x0123456789abcdefULL;
+
+/* Deterministic data, with the corner cases the shifts care about */
+static uint64_t next_rand(void)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    switch (seed >> 61) {
+    case 0:
+        return 0;
+    case 1:
+        return -1ULL;
+    case 2:
+        return 0x8080808080808080ULL;
+    default:
+        return seed ^ (seed >> 29);
+    }
+}
+
+static void fill(void *p)
+{
+    uint64_t *q = p;
+    int i;
+
+    for (i = 0; i < VEC_BYTES / 8; i++) {
+        q[i] = next_rand();
+    }
+}
+
+static void check(const char *op, const char *type, int round,
+                  const void *got, const void *expected)
+{
+    const uint8_t *g = got, *e = expected;
+    int i;
+
+    if (!memcmp(got, expected, VEC_BYTES)) {
+        return;
+    }
+    fprintf(stderr, "%s %s round %d: got ", op, type, round);
+    for (i = VEC_BYTES - 1; i >= 0; i--) {
+        fprintf(stderr, "%02x", g[i]);
+    }
+    fprintf(stderr, " expected ");
+    for (i = VEC_BYTES - 1; i >= 0; i--) {
+        fprintf(stderr, "%02x", e[i]);
+    }
+    fprintf(stderr, "\n");
+    errors++;
+}
+
+/*
+ * For each element type, the vector operations are kept out of line so
+ * that the compiler does not fold them with the constant data, and the
+ * scalar reference is computed element by element.
+ */
+#define TEST_TYPE(S, U, BITS)                                                  \
+typedef S v##S __attribute__((vector_size(VEC_BYTES)));                        \
+typedef U v##U __attribute__((vector_size(VEC_BYTES)));                        \
+                                                                               \
+enum { N_##U = VEC_BYTES / sizeof(U) };                                        \
+                                                                               \
+static __attribute__((noinline)) void                                          \
+vec_##U(v##U *r, v##S a, v##S b, v##S c, v##S d)                               \
+{                                                                              \
+    v##U ua = (v##U)a, ub = (v##U)b;                                           \
+    v##U cnt = ub & (BITS - 1);                                                \
+    v##U lt = (v##U)(a < b), ne = (v##U)(ua != ub);                            \
+    v##U sign = (v##U)(a >> (BITS - 1));                                       \
+                                                                               \
+    r[0] = ua << 3;                                                            \
+    r[1] = ua >> 5;                                                            \
+    r[2] = (v##U)(a >> (BITS - 1));                                            \
+    r[3] = (ua << 1) | (ua >> (BITS - 1));                                     \
+    r[4] = (ua << cnt) | (ua >> ((BITS - cnt) & (BITS - 1)));                  \
+    r[5] = (ua >> cnt) | (ua << ((BITS - cnt) & (BITS - 1)));                  \
+    r[6] = ua << cnt;                                                          \
+    r[7] = ua >> cnt;                                                          \
+    r[8] = (v##U)(a >> (v##S)cnt);                                             \
+    r[9] = (v##U)(a == b);                                                     \
+    r[10] = (v##U)(a != b);                                                    \
+    r[11] = (v##U)(a < b);                                                     \
+    r[12] = (v##U)(a >= b);                                                    \
+    r[13] = (v##U)(ua > ub);                                                   \
+    r[14] = (v##U)(ua <= ub);                                                  \
+    r[15] = (v##U)((ua & ub) != 0);                                            \
+    r[16] = (lt & (v##U)c) | (~lt & (v##U)d);                                  \
+    r[17] = (ne & (v##U)c) | (~ne & (v##U)d);                                  \
+    r[18] = ~(ua & ub);                                                        \
+    r[19] = ~(ua ^ ub);                                                        \
+    r[20] = (ua ^ sign) - sign;                                                \
+}                                                                              \
+                                                                               \
+static void ref_##U(U r[][N_##U], const S *a, const S *b,                      \
+                    const S *c, const S *d)                                    \
+{                                                                              \
+    int i;                                                                     \
+                                                                               \
+    for (i = 0; i < N_##U; i++) {                                              \
+        U ua = a[i], ub = b[i];                                                \
+        unsigned cnt = ub & (BITS - 1);                                        \
+        U m = -1;                                                              \
+                                                                               \
+        r[0][i] = (U)(ua << 3);                                                \
+        r[1][i] = (U)(ua >> 5);                                                \
+        r[2][i] = a[i] < 0 ? m : 0;                                            \
+        r[3][i] = (U)((ua << 1) | (ua >> (BITS - 1)));                         \
+        r[4][i] = cnt ? (U)((ua << cnt) | (ua >> (BITS - cnt))) : ua;          \
+        r[5][i] = cnt ? (U)((ua >> cnt) | (ua << (BITS - cnt))) : ua;          \
+        r[6][i] = (U)(ua << cnt);                                              \
+        r[7][i] = (U)(ua >> cnt);                                              \
+        r[8][i] = (U)(a[i] >> cnt);                                            \
+        r[9][i] = a[i] == b[i] ? m : 0;                                        \
+        r[10][i] = a[i] != b[i] ? m : 0;                                       \
+        r[11][i] = a[i] < b[i] ? m : 0;                                        \
+        r[12][i] = a[i] >= b[i] ? m : 0;                                       \
+        r[13][i] = ua > ub ? m : 0;                                            \
+        r[14][i] = ua <= ub ? m : 0;                                           \
+        r[15][i] = (ua & ub) ? m : 0;                                          \
+        r[16][i] = a[i] < b[i] ? (U)c[i] : (U)d[i];                            \
+        r[17][i] = ua != ub ? (U)c[i] : (U)d[i];                               \
+        r[18][i] = (U)~(ua & ub);                                              \
+        r[19][i] = (U)~(ua ^ ub);                                              \
+        r[20][i] = a[i] < 0 ? (U)-ua : ua;                                     \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static void test_##U(void)                                                     \
+{                                                                              \
+    int round, i;                                                              \
+                                                                               \
+    for (round = 0; round < NB_ROUNDS; round++) {                              \
+        v##S a, b, c, d;                                                       \
+        v##U r[NB_OPS];                                                        \
+        U expected[NB_OPS][N_##U];                                             \
+                                                                               \
+        fill(&a);                                                              \
+        fill(&b);                                                              \
+        fill(&c);                                                              \
+        fill(&d);                                                              \
+        /* Make some elements equal for the comparisons */                     \
+        if (round & 1) {                                                       \
+            memcpy(&b, &a, VEC_BYTES / 2);                                     \
+        }                                                                      \
+        vec_##U(r, a, b, c, d);                                                \
+        ref_##U(expected, (S *)&a, (S *)&b, (S *)&c, (S *)&d);                 \
+        for (i = 0; i < NB_OPS; i++) {                                         \
+            check(op_names[i], #U, round, &r[i], expected[i]);                 \
+        }                                                                      \
+    }                                                                          \
+}
+
+static const char *op_names[] = {
+    "shli", "shri", "sari", "rotli", "rotlv", "rotrv", "shlv", "shrv", "sarv",
+    "cmp_eq", "cmp_ne", "cmp_lt", "cmp_ge", "cmp_gtu", "cmp_leu", "cmp_tstne",
+    "cmpsel_lt", "cmpsel_ne", "nand", "eqv", "abs",
+};
+
+#define NB_OPS (int)(sizeof(op_names) / sizeof(op_names[0]))
+
+TEST_TYPE(int8_t, uint8_t, 8)
+TEST_TYPE(int16_t, uint16_t, 16)
+TEST_TYPE(int32_t, uint32_t, 32)
+TEST_TYPE(int64_t, uint64_t, 64)
+
+int main(void)
+{
+    test_uint8_t();
+    test_uint16_t();
+    test_uint32_t();
+    test_uint64_t();
+
+    if (errors) {
+        fprintf(stderr, "%d errors\n", errors);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
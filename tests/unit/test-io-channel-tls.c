@@ -46,6 +46,7 @@ struct QIOChannelTLSTestData {
     bool expectClientFail;
     const char *hostname;
     const char *const *wildcards;
+    bool ktls;
 };
 
 struct QIOChannelTLSHandshakeData {
@@ -64,7 +65,8 @@ static void test_tls_handshake_done(QIOTask *task,
 
 
 static QCryptoTLSCreds *test_tls_creds_create(QCryptoTLSCredsEndpoint endpoint,
-                                              const char *certdir)
+                                              const char *certdir,
+                                              bool ktls)
 {
     Object *parent = object_get_objects_root();
     Object *creds = object_new_with_props(
@@ -78,6 +80,7 @@ static QCryptoTLSCreds *test_tls_creds_create(QCryptoTLSCredsEndpoint endpoint,
         "dir", certdir,
         "verify-peer", "yes",
         "priority", "NORMAL",
+        "ktls", ktls ? "yes" : "no",
         /* We skip initial sanity checks here because we
          * want to make sure that problems are being
          * detected at the TLS session validation stage,
@@ -92,6 +95,54 @@ static QCryptoTLSCreds *test_tls_creds_create(QCryptoTLSCredsEndpoint endpoint,
 }
 
 
+/*
+ * Kernel TLS only works on TCP sockets, so build the equivalent of
+ * a socketpair over the loopback interface.
+ */
+static void test_tls_tcp_socketpair(int sv[2])
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof(addr);
+    int lfd;
+
+    lfd = qemu_socket(AF_INET, SOCK_STREAM, 0);
+    g_assert(lfd >= 0);
+    g_assert(bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    g_assert(listen(lfd, 1) == 0);
+    g_assert(getsockname(lfd, (struct sockaddr *)&addr, &addrlen) == 0);
+
+    sv[0] = qemu_socket(AF_INET, SOCK_STREAM, 0);
+    g_assert(sv[0] >= 0);
+    g_assert(connect(sv[0], (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    sv[1] = qemu_accept(lfd, NULL, NULL);
+    g_assert(sv[1] >= 0);
+
+    close(lfd);
+}
+
+#ifdef CONFIG_KTLS
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+/* Whether the kernel supports the "tls" upper layer protocol */
+static bool test_tls_ktls_available(void)
+{
+    int sv[2];
+    bool ret;
+
+    test_tls_tcp_socketpair(sv);
+    ret = setsockopt(sv[0], IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+    close(sv[0]);
+    close(sv[1]);
+    return ret;
+}
+#endif
+
+
 /*
  * This tests validation checking of peer certificates
  *
@@ -121,7 +172,20 @@ static void test_io_channel_tls(const void *opaque)
     GMainContext *mainloop;
 
     /* We'll use this for our fake client-server connection */
-    g_assert(qemu_socketpair(AF_UNIX, SOCK_STREAM, 0, channel) == 0);
+    if (data->ktls) {
+#ifdef CONFIG_KTLS
+        if (!test_tls_ktls_available()) {
+            g_test_skip("kernel TLS is not available");
+            return;
+        }
+#else
+        g_test_skip("kernel TLS support is not compiled in");
+        return;
+#endif
+        test_tls_tcp_socketpair(channel);
+    } else {
+        g_assert(qemu_socketpair(AF_UNIX, SOCK_STREAM, 0, channel) == 0);
+    }
 
 #define CLIENT_CERT_DIR "tests/test-io-channel-tls-client/"
 #define SERVER_CERT_DIR "tests/test-io-channel-tls-server/"
@@ -152,12 +216,12 @@ static void test_io_channel_tls(const void *opaque)
 
     clientCreds = test_tls_creds_create(
         QCRYPTO_TLS_CREDS_ENDPOINT_CLIENT,
-        CLIENT_CERT_DIR);
+        CLIENT_CERT_DIR, data->ktls);
     g_assert(clientCreds != NULL);
 
     serverCreds = test_tls_creds_create(
         QCRYPTO_TLS_CREDS_ENDPOINT_SERVER,
-        SERVER_CERT_DIR);
+        SERVER_CERT_DIR, data->ktls);
     g_assert(serverCreds != NULL);
 
     auth = qauthz_list_new("channeltlsacl",
@@ -224,6 +288,14 @@ static void test_io_channel_tls(const void *opaque)
     g_assert(clientHandshake.failed == data->expectClientFail);
     g_assert(serverHandshake.failed == data->expectServerFail);
 
+    /* Make sure the data below goes through the kernel */
+    if (data->ktls) {
+        g_assert_cmpint(clientChanTLS->ktls, ==,
+                        QCRYPTO_TLS_KTLS_TX | QCRYPTO_TLS_KTLS_RX);
+        g_assert_cmpint(serverChanTLS->ktls, ==,
+                        QCRYPTO_TLS_KTLS_TX | QCRYPTO_TLS_KTLS_RX);
+    }
+
     test = qio_channel_test_new();
     qio_channel_test_run_threads(test, false,
                                  QIO_CHANNEL(clientChanTLS),
@@ -280,11 +352,11 @@ int main(int argc, char **argv)
 # define TEST_CHANNEL(name, caCrt,                                      \
                       serverCrt, clientCrt,                             \
                       expectServerFail, expectClientFail,               \
-                      hostname, wildcards)                              \
+                      hostname, wildcards, ktls)                        \
     struct QIOChannelTLSTestData name = {                               \
         caCrt, caCrt, serverCrt, clientCrt,                             \
         expectServerFail, expectClientFail,                             \
-        hostname, wildcards                                             \
+        hostname, wildcards, ktls                                       \
     };                                                                  \
     g_test_add_data_func("/qio/channel/tls/" # name,                    \
                          &name, test_io_channel_tls);
@@ -319,7 +391,11 @@ int main(int argc, char **argv)
     };
     TEST_CHANNEL(basic, cacertreq.filename, servercertreq.filename,
                  clientcertreq.filename, false, false,
-                 "qemu.org", wildcards);
+                 "qemu.org", wildcards, false);
+    /* Falls back to gnutls where kernel TLS is not available */
+    TEST_CHANNEL(ktls, cacertreq.filename, servercertreq.filename,
+                 clientcertreq.filename, false, false,
+                 "qemu.org", wildcards, true);
 
     ret = g_test_run();
 
@@ -734,6 +734,34 @@ static void test_accounting(void)
                                 (64.0 / 13)));
 }
 
+static void test_accounting_units(void)
+{
+    throttle_config_init(&cfg);
+    cfg.buckets[THROTTLE_BPS_TOTAL].avg = 150;
+    cfg.buckets[THROTTLE_OPS_READ].avg = 150;
+
+    throttle_init(&ts);
+    throttle_config(&ts, QEMU_CLOCK_VIRTUAL, &cfg);
+
+    /* account a batch of reads */
+    throttle_account_units(&ts, THROTTLE_READ, 4096, 8);
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_BPS_TOTAL].level, 4096));
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_BPS_READ].level, 4096));
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_OPS_TOTAL].level, 8));
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_OPS_READ].level, 8));
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_BPS_WRITE].level, 0));
+
+    /* give part of it back */
+    throttle_account_units(&ts, THROTTLE_READ, -1024, -2);
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_BPS_TOTAL].level, 3072));
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_OPS_READ].level, 6));
+
+    /* levels never go below zero */
+    throttle_account_units(&ts, THROTTLE_READ, -8192, -16);
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_BPS_TOTAL].level, 0));
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_OPS_READ].level, 0));
+}
+
 static void test_groups(void)
 {
     ThrottleConfig cfg1, cfg2;
@@ -829,6 +857,7 @@ int main(int argc, char **argv)
                     test_iops_size_is_missing_limit);
     g_test_add_func("/throttle/config_functions",   test_config_functions);
     g_test_add_func("/throttle/accounting",         test_accounting);
+    g_test_add_func("/throttle/accounting_units",   test_accounting_units);
     g_test_add_func("/throttle/groups",             test_groups);
     return g_test_run();
 }
@@ -41,6 +41,7 @@ static uint32_t next_id;
 static uint32_t next_vcpu_id;
 static bool init_trace_on_startup;
 static char *trace_opts_file;
+static char *trace_opts_format;
 
 QemuOptsList qemu_trace_opts = {
     .name = "trace",
@@ -57,6 +58,9 @@ QemuOptsList qemu_trace_opts = {
         },{
             .name = "file",
             .type = QEMU_OPT_STRING,
+        },{
+            .name = "format",
+            .type = QEMU_OPT_STRING,
         },
         { /* end of list */ }
     },
@@ -239,6 +243,11 @@ static void trace_init_events(const char *fname)
 void trace_init_file(void)
 {
 #ifdef CONFIG_TRACE_SIMPLE
+    if (trace_opts_format && !st_set_trace_format(trace_opts_format)) {
+        fprintf(stderr, "error: --trace format=%s: unknown trace file format\n",
+                trace_opts_format);
+        exit(1);
+    }
     st_set_trace_file(trace_opts_file);
     if (init_trace_on_startup) {
         st_set_trace_file_enabled(true);
@@ -260,6 +269,13 @@ void trace_init_file(void)
         exit(1);
     }
 #endif
+#ifndef CONFIG_TRACE_SIMPLE
+    if (trace_opts_format) {
+        fprintf(stderr, "error: --trace format=...: "
+                "option not supported by the selected tracing backends\n");
+        exit(1);
+    }
+#endif
 }
 
 bool trace_init_backends(void)
@@ -299,6 +315,8 @@ void trace_opt_parse(const char *optstr)
     init_trace_on_startup = true;
     g_free(trace_opts_file);
     trace_opts_file = g_strdup(qemu_opt_get(opts, "file"));
+    g_free(trace_opts_format);
+    trace_opts_format = g_strdup(qemu_opt_get(opts, "format"));
     qemu_opts_del(opts);
 }
 
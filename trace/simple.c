@@ -30,9 +30,6 @@
 /** Records were dropped event ID */
 #define DROPPED_EVENT_ID (~(uint64_t)0 - 1)
 
-/** Trace record is valid */
-#define TRACE_RECORD_VALID ((uint64_t)1 << 63)
-
 /*
  * Trace records are written out by a dedicated thread.  The thread waits for
  * records to become available, writes them out, and then waits again.
@@ -45,18 +42,50 @@ static bool trace_available;
 static bool trace_writeout_enabled;
 
 enum {
-    TRACE_BUF_LEN = 4096 * 64,
+    TRACE_BUF_LEN = 4096 * 16,
     TRACE_BUF_FLUSH_THRESHOLD = TRACE_BUF_LEN / 4,
 };
 
-uint8_t trace_buf[TRACE_BUF_LEN];
-static volatile gint trace_idx;
-static unsigned int writeout_idx;
-static volatile gint dropped_events;
+/*
+ * Each thread that emits trace events owns a ring buffer.  The owning thread
+ * is the only producer and the writeout thread is the only consumer, so the
+ * ring needs no locking and no shared index: @head is only written by the
+ * producer and @tail only by the consumer.  The writeout thread merges the
+ * records pending in the rings by timestamp.  Records are therefore ordered
+ * within one writeout pass, but a record committed after a pass started may
+ * be older than records already written, so readers must not assume that
+ * the whole trace file is sorted.
+ */
+struct TraceThreadBuffer {
+    struct TraceThreadBuffer *next;
+    unsigned int head;          /* producer: end of committed records */
+    unsigned int reserved;      /* producer: end of record being written */
+    bool in_record;             /* producer: record in progress */
+    bool orphaned;              /* owning thread has exited */
+    unsigned int tail QEMU_ALIGNED(64); /* consumer: next record to read */
+    int dropped;
+    uint8_t data[TRACE_BUF_LEN];
+};
+
+static void trace_thread_buffer_release(gpointer opaque);
+
+static GPrivate trace_thread_buffer_key =
+    G_PRIVATE_INIT(trace_thread_buffer_release);
+static TraceThreadBuffer *trace_thread_buffers;
 static uint32_t trace_pid;
 static FILE *trace_fp;
 static char *trace_file_name;
 
+/*
+ * In CTF format, the trace file name is a directory holding the "metadata"
+ * and a "stream" file.  The stream contains the same records as the simple
+ * format, but neither the file header nor the record types and the event
+ * ID mappings; these are described by the metadata instead.
+ */
+static bool trace_ctf;
+static FILE *trace_metadata_fp;
+static GHashTable *trace_event_fields;
+
 #define TRACE_RECORD_TYPE_MAPPING 0
 #define TRACE_RECORD_TYPE_EVENT   1
 
@@ -76,53 +105,84 @@ typedef struct {
 } TraceLogHeader;
 
 
-static void read_from_buffer(unsigned int idx, void *dataptr, size_t size);
-static unsigned int write_to_buffer(unsigned int idx, void *dataptr, size_t size);
+static void read_from_buffer(TraceThreadBuffer *tbuf, unsigned int idx,
+                             void *dataptr, size_t size);
+static unsigned int write_to_buffer(TraceThreadBuffer *tbuf, unsigned int idx,
+                                    void *dataptr, size_t size);
 
-static void clear_buffer_range(unsigned int idx, size_t len)
+/**
+ * Return the calling thread's trace buffer, allocating it on first use
+ */
+static TraceThreadBuffer *get_thread_buffer(void)
 {
-    uint32_t num = 0;
-    while (num < len) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        trace_buf[idx++] = 0;
-        num++;
+    TraceThreadBuffer *tbuf = g_private_get(&trace_thread_buffer_key);
+    TraceThreadBuffer *old;
+
+    if (likely(tbuf)) {
+        return tbuf;
     }
+
+    tbuf = calloc(1, sizeof(*tbuf)); /* don't use g_malloc, can deadlock */
+    if (!tbuf) {
+        return NULL;
+    }
+    g_private_set(&trace_thread_buffer_key, tbuf);
+
+    /* Lock-free push; only the writeout thread ever unlinks buffers */
+    do {
+        old = qatomic_read(&trace_thread_buffers);
+        tbuf->next = old;
+    } while (qatomic_cmpxchg(&trace_thread_buffers, old, tbuf) != old);
+    return tbuf;
 }
+
+static void trace_thread_buffer_release(gpointer opaque)
+{
+    TraceThreadBuffer *tbuf = opaque;
+
+    /* The writeout thread frees the buffer once it has been drained */
+    qatomic_store_release(&tbuf->orphaned, true);
+}
+
 /**
- * Read a trace record from the trace buffer
+ * Peek at the timestamp of the oldest unread record in a buffer
  *
- * @idx         Trace buffer index
- * @record      Trace record to fill
+ * @tbuf        Trace buffer
+ * @head        Snapshot of the buffer's committed head
+ * @ts          Timestamp of the record
  *
- * Returns false if the record is not valid.
+ * Returns false if the buffer has no unread records before @head.
  */
-static bool get_trace_record(unsigned int idx, TraceRecord **recordptr)
+static bool peek_trace_record(TraceThreadBuffer *tbuf, unsigned int head,
+                              uint64_t *ts)
 {
-    uint64_t event_flag = 0;
     TraceRecord record;
-    /* read the event flag to see if its a valid record */
-    read_from_buffer(idx, &record, sizeof(event_flag));
 
-    if (!(record.event & TRACE_RECORD_VALID)) {
+    if (tbuf->tail == head) {
         return false;
     }
+    read_from_buffer(tbuf, tbuf->tail, &record, sizeof(record));
+    *ts = record.timestamp_ns;
+    return true;
+}
+
+/**
+ * Read the oldest trace record from a buffer and release its space
+ *
+ * @tbuf        Trace buffer
+ * @record      Trace record to fill
+ */
+static void get_trace_record(TraceThreadBuffer *tbuf, TraceRecord **recordptr)
+{
+    TraceRecord record;
 
-    smp_rmb(); /* read memory barrier before accessing record */
     /* read the record header to know record length */
-    read_from_buffer(idx, &record, sizeof(TraceRecord));
+    read_from_buffer(tbuf, tbuf->tail, &record, sizeof(TraceRecord));
     *recordptr = malloc(record.length); /* don't use g_malloc, can deadlock when traced */
     /* make a copy of record to avoid being overwritten */
-    read_from_buffer(idx, *recordptr, record.length);
-    smp_rmb(); /* memory barrier before clearing valid flag */
-    (*recordptr)->event &= ~TRACE_RECORD_VALID;
-    /* clear the trace buffer range for consumed record otherwise any byte
-     * with its MSB set may be considered as a valid event id when the writer
-     * thread crosses this range of buffer again.
-     */
-    clear_buffer_range(idx, record.length);
-    return true;
+    read_from_buffer(tbuf, tbuf->tail, *recordptr, record.length);
+    /* the copy must complete before the producer may reuse the space */
+    qatomic_store_release(&tbuf->tail, tbuf->tail + record.length);
 }
 
 /**
@@ -154,6 +214,41 @@ static void wait_for_trace_records_available(void)
     g_mutex_unlock(&trace_lock);
 }
 
+/**
+ * Free the buffers of exited threads once they have been fully drained
+ *
+ * Only the writeout thread unlinks buffers, so the list can be walked
+ * without a lock; new buffers are only ever pushed at the list head.
+ */
+static void reap_thread_buffers(void)
+{
+    TraceThreadBuffer **prev = &trace_thread_buffers;
+    TraceThreadBuffer *tbuf = qatomic_load_acquire(prev);
+
+    while (tbuf) {
+        TraceThreadBuffer *next = tbuf->next;
+
+        if (qatomic_load_acquire(&tbuf->orphaned) &&
+            qatomic_load_acquire(&tbuf->head) == tbuf->tail &&
+            !qatomic_read(&tbuf->dropped)) {
+            if (prev == &trace_thread_buffers) {
+                if (qatomic_cmpxchg(prev, tbuf, next) != tbuf) {
+                    /* A new buffer was pushed, find our predecessor again */
+                    prev = &trace_thread_buffers;
+                    tbuf = qatomic_load_acquire(prev);
+                    continue;
+                }
+            } else {
+                *prev = next;
+            }
+            free(tbuf);
+        } else {
+            prev = &tbuf->next;
+        }
+        tbuf = next;
+    }
+}
+
 static gpointer writeout_thread(gpointer opaque)
 {
     TraceRecord *recordptr;
@@ -161,121 +256,151 @@ static gpointer writeout_thread(gpointer opaque)
         TraceRecord rec;
         uint8_t bytes[sizeof(TraceRecord) + sizeof(uint64_t)];
     } dropped;
-    unsigned int idx = 0;
+    TraceThreadBuffer *tbuf, *oldest;
     int dropped_count;
     size_t unused __attribute__ ((unused));
     uint64_t type = TRACE_RECORD_TYPE_EVENT;
+    uint64_t ts, oldest_ts;
 
     for (;;) {
         wait_for_trace_records_available();
 
-        if (g_atomic_int_get(&dropped_events)) {
+        dropped_count = 0;
+        for (tbuf = qatomic_load_acquire(&trace_thread_buffers); tbuf;
+             tbuf = tbuf->next) {
+            dropped_count += qatomic_xchg(&tbuf->dropped, 0);
+        }
+        if (dropped_count) {
             dropped.rec.event = DROPPED_EVENT_ID;
             dropped.rec.timestamp_ns = get_clock();
             dropped.rec.length = sizeof(TraceRecord) + sizeof(uint64_t);
             dropped.rec.pid = trace_pid;
-            do {
-                dropped_count = g_atomic_int_get(&dropped_events);
-            } while (!g_atomic_int_compare_and_exchange(&dropped_events,
-                                                        dropped_count, 0));
             dropped.rec.arguments[0] = dropped_count;
-            unused = fwrite(&type, sizeof(type), 1, trace_fp);
+            if (!trace_ctf) {
+                unused = fwrite(&type, sizeof(type), 1, trace_fp);
+            }
             unused = fwrite(&dropped.rec, dropped.rec.length, 1, trace_fp);
         }
 
-        while (get_trace_record(idx, &recordptr)) {
-            unused = fwrite(&type, sizeof(type), 1, trace_fp);
+        /*
+         * Merge the per-thread buffers: repeatedly write out the oldest
+         * pending record across all threads.  Each ring is in timestamp
+         * order, so the records of this pass are written in order; the
+         * "dropped" record above carries the time of the pass instead.
+         */
+        for (;;) {
+            oldest = NULL;
+            oldest_ts = 0;
+            for (tbuf = qatomic_load_acquire(&trace_thread_buffers); tbuf;
+                 tbuf = tbuf->next) {
+                if (peek_trace_record(tbuf, qatomic_load_acquire(&tbuf->head),
+                                      &ts) &&
+                    (!oldest || ts < oldest_ts)) {
+                    oldest = tbuf;
+                    oldest_ts = ts;
+                }
+            }
+            if (!oldest) {
+                break;
+            }
+            get_trace_record(oldest, &recordptr);
+            if (!trace_ctf) {
+                unused = fwrite(&type, sizeof(type), 1, trace_fp);
+            }
             unused = fwrite(recordptr, recordptr->length, 1, trace_fp);
-            writeout_idx += recordptr->length;
             free(recordptr); /* don't use g_free, can deadlock when traced */
-            idx = writeout_idx % TRACE_BUF_LEN;
         }
 
         fflush(trace_fp);
+        reap_thread_buffers();
     }
     return NULL;
 }
 
 void trace_record_write_u64(TraceBufferRecord *rec, uint64_t val)
 {
-    rec->rec_off = write_to_buffer(rec->rec_off, &val, sizeof(uint64_t));
+    rec->rec_off = write_to_buffer(rec->tbuf, rec->rec_off,
+                                   &val, sizeof(uint64_t));
 }
 
 void trace_record_write_str(TraceBufferRecord *rec, const char *s, uint32_t slen)
 {
     /* Write string length first */
-    rec->rec_off = write_to_buffer(rec->rec_off, &slen, sizeof(slen));
+    rec->rec_off = write_to_buffer(rec->tbuf, rec->rec_off,
+                                   &slen, sizeof(slen));
     /* Write actual string now */
-    rec->rec_off = write_to_buffer(rec->rec_off, (void*)s, slen);
+    rec->rec_off = write_to_buffer(rec->tbuf, rec->rec_off, (void*)s, slen);
 }
 
 int trace_record_start(TraceBufferRecord *rec, uint32_t event, size_t datasize)
 {
-    unsigned int idx, rec_off, old_idx, new_idx;
+    TraceThreadBuffer *tbuf = get_thread_buffer();
+    unsigned int idx, rec_off, new_idx;
     uint32_t rec_len = sizeof(TraceRecord) + datasize;
     uint64_t event_u64 = event;
     uint64_t timestamp_ns = get_clock();
 
-    do {
-        old_idx = g_atomic_int_get(&trace_idx);
-        smp_rmb();
-        new_idx = old_idx + rec_len;
-
-        if (new_idx - writeout_idx > TRACE_BUF_LEN) {
-            /* Trace Buffer Full, Event dropped ! */
-            g_atomic_int_inc(&dropped_events);
-            return -ENOSPC;
-        }
-    } while (!g_atomic_int_compare_and_exchange(&trace_idx, old_idx, new_idx));
+    if (unlikely(!tbuf)) {
+        return -ENOMEM;
+    }
+
+    /* A signal handler that traces while a record is open loses its event */
+    if (unlikely(tbuf->in_record)) {
+        qatomic_inc(&tbuf->dropped);
+        return -EBUSY;
+    }
 
-    idx = old_idx % TRACE_BUF_LEN;
+    idx = tbuf->head;
+    new_idx = idx + rec_len;
+    if (new_idx - qatomic_load_acquire(&tbuf->tail) > TRACE_BUF_LEN) {
+        /* Trace Buffer Full, Event dropped ! */
+        qatomic_inc(&tbuf->dropped);
+        return -ENOSPC;
+    }
+    tbuf->in_record = true;
+    tbuf->reserved = new_idx;
 
     rec_off = idx;
-    rec_off = write_to_buffer(rec_off, &event_u64, sizeof(event_u64));
-    rec_off = write_to_buffer(rec_off, &timestamp_ns, sizeof(timestamp_ns));
-    rec_off = write_to_buffer(rec_off, &rec_len, sizeof(rec_len));
-    rec_off = write_to_buffer(rec_off, &trace_pid, sizeof(trace_pid));
+    rec_off = write_to_buffer(tbuf, rec_off, &event_u64, sizeof(event_u64));
+    rec_off = write_to_buffer(tbuf, rec_off, &timestamp_ns, sizeof(timestamp_ns));
+    rec_off = write_to_buffer(tbuf, rec_off, &rec_len, sizeof(rec_len));
+    rec_off = write_to_buffer(tbuf, rec_off, &trace_pid, sizeof(trace_pid));
 
-    rec->tbuf_idx = idx;
-    rec->rec_off  = (idx + sizeof(TraceRecord)) % TRACE_BUF_LEN;
+    rec->tbuf = tbuf;
+    rec->rec_off  = rec_off;
     return 0;
 }
 
-static void read_from_buffer(unsigned int idx, void *dataptr, size_t size)
+static void read_from_buffer(TraceThreadBuffer *tbuf, unsigned int idx,
+                             void *dataptr, size_t size)
 {
-    uint8_t *data_ptr = dataptr;
-    uint32_t x = 0;
-    while (x < size) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        data_ptr[x++] = trace_buf[idx++];
-    }
+    unsigned int off = idx % TRACE_BUF_LEN;
+    size_t first = MIN(size, TRACE_BUF_LEN - off);
+
+    memcpy(dataptr, &tbuf->data[off], first);
+    memcpy((uint8_t *)dataptr + first, tbuf->data, size - first);
 }
 
-static unsigned int write_to_buffer(unsigned int idx, void *dataptr, size_t size)
+static unsigned int write_to_buffer(TraceThreadBuffer *tbuf, unsigned int idx,
+                                    void *dataptr, size_t size)
 {
-    uint8_t *data_ptr = dataptr;
-    uint32_t x = 0;
-    while (x < size) {
-        if (idx >= TRACE_BUF_LEN) {
-            idx = idx % TRACE_BUF_LEN;
-        }
-        trace_buf[idx++] = data_ptr[x++];
-    }
-    return idx; /* most callers wants to know where to write next */
+    unsigned int off = idx % TRACE_BUF_LEN;
+    size_t first = MIN(size, TRACE_BUF_LEN - off);
+
+    memcpy(&tbuf->data[off], dataptr, first);
+    memcpy(tbuf->data, (uint8_t *)dataptr + first, size - first);
+    return idx + size; /* most callers wants to know where to write next */
 }
 
 void trace_record_finish(TraceBufferRecord *rec)
 {
-    TraceRecord record;
-    read_from_buffer(rec->tbuf_idx, &record, sizeof(TraceRecord));
-    smp_wmb(); /* write barrier before marking as valid */
-    record.event |= TRACE_RECORD_VALID;
-    write_to_buffer(rec->tbuf_idx, &record, sizeof(TraceRecord));
+    TraceThreadBuffer *tbuf = rec->tbuf;
+
+    /* Publish the record to the writeout thread */
+    qatomic_store_release(&tbuf->head, tbuf->reserved);
+    tbuf->in_record = false;
 
-    if (((unsigned int)g_atomic_int_get(&trace_idx) - writeout_idx)
-        > TRACE_BUF_FLUSH_THRESHOLD) {
+    if (tbuf->head - qatomic_read(&tbuf->tail) > TRACE_BUF_FLUSH_THRESHOLD) {
         flush_trace_file(false);
     }
 }
@@ -300,6 +425,162 @@ static int st_write_event_mapping(TraceEventIter *iter)
     return 0;
 }
 
+void st_register_event_fields(const SimpleTraceEventFields *fields)
+{
+    if (!trace_event_fields) {
+        trace_event_fields = g_hash_table_new(NULL, NULL);
+    }
+    for (; fields->ev; fields++) {
+        g_hash_table_insert(trace_event_fields, fields->ev,
+                            (gpointer)fields->fields);
+    }
+}
+
+static int st_write_ctf_events(TraceEventIter *iter)
+{
+    TraceEvent *ev;
+
+    while ((ev = trace_event_iter_next(iter)) != NULL) {
+        const char *fields = trace_event_fields ?
+            g_hash_table_lookup(trace_event_fields, ev) : NULL;
+
+        /* Events that are disabled at build time are never recorded */
+        if (!fields) {
+            continue;
+        }
+        if (fprintf(trace_metadata_fp,
+                    "event {\n"
+                    "    name = \"%s\";\n"
+                    "    id = %" PRIu32 ";\n"
+                    "    fields := struct { %s };\n"
+                    "};\n\n",
+                    trace_event_get_name(ev), trace_event_get_id(ev),
+                    fields) < 0) {
+            return -1;
+        }
+    }
+
+    return fflush(trace_metadata_fp) ? -1 : 0;
+}
+
+/*
+ * The records are laid out without any padding, so all types are declared
+ * byte-aligned.  Argument names start with an underscore, which readers
+ * strip, so that they cannot clash with TSDL keywords.
+ */
+static int st_write_ctf_metadata(void)
+{
+    TraceEventIter iter;
+
+    if (fprintf(trace_metadata_fp,
+                "/* CTF 1.8 */\n\n"
+                "typealias integer { size = 8; align = 8; signed = false;"
+                " encoding = UTF8; } := utf8_t;\n"
+                "typealias integer { size = 32; align = 8; signed = false; }"
+                " := uint32_t;\n"
+                "typealias integer { size = 64; align = 8; signed = false; }"
+                " := uint64_t;\n"
+                "typealias integer { size = 64; align = 8; signed = true; }"
+                " := int64_t;\n"
+                "typealias integer { size = 64; align = 8; signed = false;"
+                " base = hex; } := ptr_t;\n\n"
+                "trace {\n"
+                "    major = 1;\n"
+                "    minor = 8;\n"
+                "    byte_order = %s;\n"
+                "};\n\n"
+                "env {\n"
+                "    domain = \"qemu\";\n"
+                "    pid = %" PRIu32 ";\n"
+                "};\n\n"
+                "clock {\n"
+                "    name = monotonic;\n"
+                "    freq = 1000000000;\n"
+                "};\n\n"
+                "typealias integer { size = 64; align = 8; signed = false;"
+                " map = clock.monotonic.value; } := uint64_clock_t;\n\n"
+                "stream {\n"
+                "    event.header := struct {\n"
+                "        uint64_t id;\n"
+                "        uint64_clock_t timestamp;\n"
+                "        uint32_t length;\n"
+                "        uint32_t pid;\n"
+                "    };\n"
+                "};\n\n"
+                "event {\n"
+                "    name = \"dropped\";\n"
+                "    id = %" PRIu64 ";\n"
+                "    fields := struct { uint64_t _dropped_events; };\n"
+                "};\n\n",
+                HOST_BIG_ENDIAN ? "be" : "le", trace_pid,
+                DROPPED_EVENT_ID) < 0) {
+        return -1;
+    }
+
+    trace_event_iter_init_all(&iter);
+    return st_write_ctf_events(&iter);
+}
+
+static bool st_open_ctf_trace(void)
+{
+    g_autofree char *metadata = NULL;
+    g_autofree char *stream = NULL;
+
+    if (g_mkdir_with_parents(trace_file_name, 0755) < 0) {
+        return false;
+    }
+
+    metadata = g_build_filename(trace_file_name, "metadata", NULL);
+    trace_metadata_fp = fopen(metadata, "w");
+    if (!trace_metadata_fp) {
+        return false;
+    }
+    if (st_write_ctf_metadata() < 0) {
+        goto fail;
+    }
+
+    stream = g_build_filename(trace_file_name, "stream", NULL);
+    trace_fp = fopen(stream, "wb");
+    if (!trace_fp) {
+        goto fail;
+    }
+    return true;
+
+fail:
+    fclose(trace_metadata_fp);
+    trace_metadata_fp = NULL;
+    return false;
+}
+
+static bool st_open_trace(void)
+{
+    static const TraceLogHeader header = {
+        .header_event_id = HEADER_EVENT_ID,
+        .header_magic = HEADER_MAGIC,
+        /* Older log readers will check for version at next location */
+        .header_version = HEADER_VERSION,
+    };
+    TraceEventIter iter;
+
+    if (trace_ctf) {
+        return st_open_ctf_trace();
+    }
+
+    trace_fp = fopen(trace_file_name, "wb");
+    if (!trace_fp) {
+        return false;
+    }
+
+    trace_event_iter_init_all(&iter);
+    if (fwrite(&header, sizeof header, 1, trace_fp) != 1 ||
+        st_write_event_mapping(&iter) < 0) {
+        fclose(trace_fp);
+        trace_fp = NULL;
+        return false;
+    }
+    return true;
+}
+
 /**
  * Enable / disable tracing, return whether it was enabled.
  *
@@ -307,7 +588,6 @@ static int st_write_event_mapping(TraceEventIter *iter)
  */
 bool st_set_trace_file_enabled(bool enable)
 {
-    TraceEventIter iter;
     bool was_enabled = trace_fp;
 
     if (enable == !!trace_fp) {
@@ -320,23 +600,7 @@ bool st_set_trace_file_enabled(bool enable)
     flush_trace_file(true);
 
     if (enable) {
-        static const TraceLogHeader header = {
-            .header_event_id = HEADER_EVENT_ID,
-            .header_magic = HEADER_MAGIC,
-            /* Older log readers will check for version at next location */
-            .header_version = HEADER_VERSION,
-        };
-
-        trace_fp = fopen(trace_file_name, "wb");
-        if (!trace_fp) {
-            return was_enabled;
-        }
-
-        trace_event_iter_init_all(&iter);
-        if (fwrite(&header, sizeof header, 1, trace_fp) != 1 ||
-            st_write_event_mapping(&iter) < 0) {
-            fclose(trace_fp);
-            trace_fp = NULL;
+        if (!st_open_trace()) {
             return was_enabled;
         }
 
@@ -346,6 +610,10 @@ bool st_set_trace_file_enabled(bool enable)
     } else {
         fclose(trace_fp);
         trace_fp = NULL;
+        if (trace_metadata_fp) {
+            fclose(trace_metadata_fp);
+            trace_metadata_fp = NULL;
+        }
     }
     return was_enabled;
 }
@@ -372,10 +640,35 @@ void st_set_trace_file(const char *file)
     st_set_trace_file_enabled(saved_enable);
 }
 
+/**
+ * Set the format of the trace file, return false if it is unknown
+ *
+ * @format      "simple" or "ctf"
+ */
+bool st_set_trace_format(const char *format)
+{
+    bool saved_enable;
+    bool ctf;
+
+    if (!strcmp(format, "simple")) {
+        ctf = false;
+    } else if (!strcmp(format, "ctf")) {
+        ctf = true;
+    } else {
+        return false;
+    }
+
+    saved_enable = st_set_trace_file_enabled(false);
+    trace_ctf = ctf;
+    st_set_trace_file_enabled(saved_enable);
+    return true;
+}
+
 void st_print_trace_file_status(void)
 {
-    qemu_printf("Trace file \"%s\" %s.\n",
-                trace_file_name, trace_fp ? "on" : "off");
+    qemu_printf("Trace file \"%s\" %s (%s format).\n",
+                trace_file_name, trace_fp ? "on" : "off",
+                trace_ctf ? "ctf" : "simple");
 }
 
 void st_flush_trace_buffer(void)
@@ -432,5 +725,10 @@ void st_init_group(size_t group)
     }
 
     trace_event_iter_init_group(&iter, group);
-    st_write_event_mapping(&iter);
+    if (trace_ctf) {
+        /* Readers take the metadata as a whole, it can grow at any time */
+        st_write_ctf_events(&iter);
+    } else {
+        st_write_event_mapping(&iter);
+    }
 }
@@ -11,15 +11,20 @@
 #ifndef TRACE_SIMPLE_H
 #define TRACE_SIMPLE_H
 
+#include "trace/event-internal.h"
+
 void st_print_trace_file_status(void);
 bool st_set_trace_file_enabled(bool enable);
 void st_set_trace_file(const char *file);
+bool st_set_trace_format(const char *format);
 bool st_init(void);
 void st_init_group(size_t group);
 void st_flush_trace_buffer(void);
 
+typedef struct TraceThreadBuffer TraceThreadBuffer;
+
 typedef struct {
-    unsigned int tbuf_idx;
+    TraceThreadBuffer *tbuf;
     unsigned int rec_off;
 } TraceBufferRecord;
 
@@ -42,6 +47,23 @@ void trace_record_write_u64(TraceBufferRecord *rec, uint64_t val);
  */
 void trace_record_write_str(TraceBufferRecord *rec, const char *s, uint32_t slen);
 
+/**
+ * CTF declaration of the arguments of a trace event, e.g.
+ * "uint64_t _offset; uint32_t _name_len; utf8_t _name[_name_len];"
+ */
+typedef struct {
+    TraceEvent *ev;
+    const char *fields;
+} SimpleTraceEventFields;
+
+/**
+ * Register the argument declarations of a group of trace events, for the
+ * metadata of traces written in CTF format
+ *
+ * @fields  Array terminated by an entry with a NULL event
+ */
+void st_register_event_fields(const SimpleTraceEventFields *fields);
+
 /**
  * Mark a trace record completed
  *
@@ -462,13 +462,30 @@ bool throttle_schedule_timer(ThrottleState *ts,
     return true;
 }
 
-/* do the accounting for this operation
+/* Tell whether an I/O request would have to wait right now
+ *
+ * @clock_type: the clock used by the throttle state
+ * @direction:  throttle direction
+ * @ret:        true if the request must wait
+ */
+bool throttle_must_wait(ThrottleState *ts, QEMUClockType clock_type,
+                        ThrottleDirection direction)
+{
+    int64_t next_timestamp;
+
+    assert(direction < THROTTLE_MAX);
+    return throttle_compute_timer(ts, direction, qemu_clock_get_ns(clock_type),
+                                  &next_timestamp);
+}
+
+/* add (or, if negative, give back) bytes and operations to the buckets
  *
  * @direction: throttle direction
- * @size:     the size of the operation
+ * @size:      the number of bytes
+ * @units:     the number of operations
  */
-void throttle_account(ThrottleState *ts, ThrottleDirection direction,
-                      uint64_t size)
+void throttle_account_units(ThrottleState *ts, ThrottleDirection direction,
+                            double size, double units)
 {
     static const BucketType bucket_types_size[THROTTLE_MAX][2] = {
         { THROTTLE_BPS_TOTAL, THROTTLE_BPS_READ },
@@ -478,32 +495,45 @@ void throttle_account(ThrottleState *ts, ThrottleDirection direction,
         { THROTTLE_OPS_TOTAL, THROTTLE_OPS_READ },
         { THROTTLE_OPS_TOTAL, THROTTLE_OPS_WRITE }
     };
-    double units = 1.0;
     unsigned i;
 
     assert(direction < THROTTLE_MAX);
-    /* if cfg.op_size is defined and smaller than size we compute unit count */
-    if (ts->cfg.op_size && size > ts->cfg.op_size) {
-        units = (double) size / ts->cfg.op_size;
-    }
 
     for (i = 0; i < ARRAY_SIZE(bucket_types_size[THROTTLE_READ]); i++) {
         LeakyBucket *bkt;
 
         bkt = &ts->cfg.buckets[bucket_types_size[direction][i]];
-        bkt->level += size;
+        bkt->level = MAX(bkt->level + size, 0);
         if (bkt->burst_length > 1) {
-            bkt->burst_level += size;
+            bkt->burst_level = MAX(bkt->burst_level + size, 0);
         }
 
         bkt = &ts->cfg.buckets[bucket_types_units[direction][i]];
-        bkt->level += units;
+        bkt->level = MAX(bkt->level + units, 0);
         if (bkt->burst_length > 1) {
-            bkt->burst_level += units;
+            bkt->burst_level = MAX(bkt->burst_level + units, 0);
         }
     }
 }
 
+/* do the accounting for this operation
+ *
+ * @direction: throttle direction
+ * @size:     the size of the operation
+ */
+void throttle_account(ThrottleState *ts, ThrottleDirection direction,
+                      uint64_t size)
+{
+    double units = 1.0;
+
+    /* if cfg.op_size is defined and smaller than size we compute unit count */
+    if (ts->cfg.op_size && size > ts->cfg.op_size) {
+        units = (double) size / ts->cfg.op_size;
+    }
+
+    throttle_account_units(ts, direction, size, units);
+}
+
 /* return a ThrottleConfig based on the options in a ThrottleLimits
  *
  * @arg:    the ThrottleLimits object to read from